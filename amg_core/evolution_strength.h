@@ -0,0 +1,219 @@
+#ifndef __EVOLUTION_STRENGTH_H__
+#define __EVOLUTION_STRENGTH_H__
+
+/*
+ * Evolution (ODE) strength of connection for smoothed aggregation,
+ * after pyamg's amg_core/evolution_strength.h.
+ *
+ * The measure evolves each delta_i by (I - dt/rho D^-1 A)^k restricted
+ * to the pattern of A (incomplete_mat_mult_csr), fits every row by the
+ * near-nullspace B, exactly at the diagonal (evolution_strength_helper),
+ * and keeps the entries whose relative fit error is within epsilon of
+ * the best of their row (apply_distance_filter).
+ *
+ * The local least-squares problems are n x n with n the number of
+ * columns of B; the common sizes 1 to 6 have their own instantiation
+ * in linalg.h, with the work arrays on the stack.
+ */
+
+#include <vector>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "util.h"
+#include "linalg.h"
+
+// begin{docstring}
+//
+// Replace the entries of S by the error of a constrained least-squares
+// fit of each row by the near-nullspace B
+//
+// For row i with entries z_j = S[i,j], solve
+//
+//     min_c  sum_j |z_j - B[j,:] c|^2   such that   B[i,:] c = S[i,i]
+//
+// and set S[i,j] = |z_j - B[j,:] c| / |z_j|: small values are strong.
+//
+// Parameters
+// ----------
+// Sx : array, inplace
+//     CSR data array of S
+// Sp : array
+//     CSR row pointer of S
+// Sj : array
+//     CSR column indices of S
+// n_row : int
+//     number of rows of S
+// B : array
+//     near-nullspace vectors, shape (n_col, NullDim), row-major
+// NullDim : int
+//     number of columns of B
+// tol : scalar
+//     relative pivot tolerance of the local solves, e.g. 1e-10
+//
+// Notes
+// -----
+// The diagonal and explicit zeros are set to 0.  A row of B that is
+// zero at the diagonal leaves the fit unconstrained.  Locally rank
+// deficient B (rows shorter than NullDim, or dependent columns) is
+// handled by dropping dependent columns.
+//
+// Rows are fitted in parallel without allocating per row.
+// end{docstring}
+template <class I, class T>
+void evolution_strength_helper(      T Sx[],
+                               const I Sp[],
+                               const I Sj[],
+                               const I n_row,
+                               const T B[],
+                               const I NullDim,
+                               const T tol)
+{
+    switch(NullDim){
+        case 1: constrained_fit_rows<1>(n_row, Sp, Sj, Sx, B, NullDim, tol); break;
+        case 2: constrained_fit_rows<2>(n_row, Sp, Sj, Sx, B, NullDim, tol); break;
+        case 3: constrained_fit_rows<3>(n_row, Sp, Sj, Sx, B, NullDim, tol); break;
+        case 4: constrained_fit_rows<4>(n_row, Sp, Sj, Sx, B, NullDim, tol); break;
+        case 5: constrained_fit_rows<5>(n_row, Sp, Sj, Sx, B, NullDim, tol); break;
+        case 6: constrained_fit_rows<6>(n_row, Sp, Sj, Sx, B, NullDim, tol); break;
+        default: constrained_fit_rows<0>(n_row, Sp, Sj, Sx, B, NullDim, tol);
+    }
+}
+
+// begin{docstring}
+//
+// Compute S = A*B only on the sparsity pattern of S
+//
+// Parameters
+// ----------
+// Ap, Aj, Ax : array
+//     CSR matrix A, shape (n_row, n_inner)
+// Bp, Bj, Bx : array
+//     CSR matrix B, shape (n_inner, n_col)
+// Sp, Sj : array
+//     CSR pattern of S, shape (n_row, n_col)
+// Sx : array, inplace
+//     CSR data array of S, overwritten by the entries of A*B
+// n_row : int
+//     number of rows of A and S
+// n_col : int
+//     number of columns of B and S
+//
+// Notes
+// -----
+// Row i of A*B is accumulated into the positions of row i of S, so
+// neither A nor B needs sorted indices, and the products outside the
+// pattern are skipped.  S must not have duplicate entries.  pyamg
+// takes B in CSC; here it is CSR, as A is.
+//
+// Rows are computed in parallel.  Each thread marks the pattern of its
+// current row in one array of n_col indices.
+// end{docstring}
+template <class I, class T>
+void incomplete_mat_mult_csr(const I Ap[],
+                             const I Aj[],
+                             const T Ax[],
+                             const I Bp[],
+                             const I Bj[],
+                             const T Bx[],
+                             const I Sp[],
+                             const I Sj[],
+                                   T Sx[],
+                             const I n_row,
+                             const I n_col)
+{
+    #pragma omp parallel if(Sp[n_row] > parallel_threshold)
+    {
+        std::vector<I> position(n_col, -1);
+
+        #pragma omp for schedule(dynamic, 64)
+        for(I i = 0; i < n_row; i++){
+            if(Sp[i] == Sp[i+1]){
+                continue;
+            }
+            for(I jj = Sp[i]; jj < Sp[i+1]; jj++){
+                position[Sj[jj]] = jj;
+                Sx[jj] = 0;
+            }
+            for(I kk = Ap[i]; kk < Ap[i+1]; kk++){
+                const I k = Aj[kk];
+                const T a = Ax[kk];
+                for(I ll = Bp[k]; ll < Bp[k+1]; ll++){
+                    const I jj = position[Bj[ll]];
+                    if(jj >= 0){
+                        Sx[jj] += a * Bx[ll];
+                    }
+                }
+            }
+            for(I jj = Sp[i]; jj < Sp[i+1]; jj++){
+                position[Sj[jj]] = -1;
+            }
+        }
+    }
+}
+
+// begin{docstring}
+//
+// Keep the entries of each row of S within a factor epsilon of the
+// smallest off-diagonal entry of the row
+//
+// Parameters
+// ----------
+// n_row : int
+//     number of rows of S
+// epsilon : scalar
+//     drop tolerance, epsilon >= 1
+// Sp : array
+//     CSR row pointer of S
+// Sj : array
+//     CSR column indices of S
+// Sx : array, inplace
+//     CSR data array of S, e.g. from evolution_strength_helper
+//
+// Notes
+// -----
+// Entries larger than epsilon times the row minimum are weak and set
+// to 0; the diagonal is set to 1.  pyamg drops the entries equal to the
+// threshold as well; here they are kept, so that a row whose best fit
+// is exact (minimum 0) keeps its exact connections.  Values are
+// compared by their real part.
+//
+// Rows are filtered in parallel.
+// end{docstring}
+template <class I, class T>
+void apply_distance_filter(const I n_row,
+                           const T epsilon,
+                           const I Sp[],
+                           const I Sj[],
+                                 T Sx[])
+{
+    const double eps = real_part(epsilon);
+
+    #pragma omp parallel for schedule(dynamic, 64) if(Sp[n_row] > parallel_threshold)
+    for(I i = 0; i < n_row; i++){
+        bool found = false;
+        double min_offdiagonal = 0;
+        for(I jj = Sp[i]; jj < Sp[i+1]; jj++){
+            if(Sj[jj] != i){
+                const double s = real_part(Sx[jj]);
+                if(!found || s < min_offdiagonal){
+                    min_offdiagonal = s;
+                    found = true;
+                }
+            }
+        }
+
+        const double threshold = eps * min_offdiagonal;
+        for(I jj = Sp[i]; jj < Sp[i+1]; jj++){
+            if(Sj[jj] == i){
+                Sx[jj] = 1;
+            } else if(real_part(Sx[jj]) > threshold){
+                Sx[jj] = 0;
+            }
+        }
+    }
+}
+
+#endif
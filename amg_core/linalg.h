@@ -0,0 +1,262 @@
+#ifndef __LINALG_H__
+#define __LINALG_H__
+
+/*
+ * Small dense linear algebra for the per-row problems of the AMG setup
+ * kernels in this directory.
+ *
+ * The problems are n x n with n the number of near-nullspace vectors,
+ * a handful at most.  Every routine takes the size as a template
+ * parameter K and as a run-time argument: for K > 0 the run-time value
+ * is ignored, so the loops have constant trip counts and the compiler
+ * unrolls them; K = 0 is the general case.  Work arrays are passed in
+ * by the caller, once per thread, so no routine allocates.
+ *
+ * Matrices are C-contiguous.
+ */
+
+#include <vector>
+
+#include "util.h"
+
+
+/*
+ * Solve the Hermitian positive semi-definite system M*x = b in the
+ * least-squares sense
+ *
+ * M is factored as L*D*L^H without pivoting.  A pivot that is not
+ * larger than tol times its diagonal entry of M marks a column that
+ * depends on the columns before it; that column is dropped and its
+ * unknown set to zero.  Any least-squares solution gives the same
+ * M*x, so a basic solution is enough for fitting.
+ *
+ * M (n x n, both triangles) is overwritten by L below the diagonal and
+ * D on it; b is overwritten by x.
+ */
+template <int K, class I, class T>
+void hermitian_lsq_solve(const I n_, T M[], T b[], const T tol)
+{
+    const I n = K > 0 ? K : n_;
+    const double rtol = real_part(tol);
+
+    for(I k = 0; k < n; k++){
+        T d = M[n*k + k];
+        const double mkk = real_part(d);
+        for(I l = 0; l < k; l++){
+            d = d - M[n*k + l] * conjugate(M[n*k + l]) * M[n*l + l];
+        }
+        if(!(real_part(d) > rtol * mkk)){
+            M[n*k + k] = 0;
+            for(I i = k + 1; i < n; i++){
+                M[n*i + k] = 0;
+            }
+            continue;
+        }
+        M[n*k + k] = d;
+        for(I i = k + 1; i < n; i++){
+            T s = M[n*i + k];
+            for(I l = 0; l < k; l++){
+                s = s - M[n*i + l] * conjugate(M[n*k + l]) * M[n*l + l];
+            }
+            M[n*i + k] = T(s / d);
+        }
+    }
+
+    // L*y = b, then D*z = y and L^H*x = z; dropped unknowns stay zero
+    for(I k = 0; k < n; k++){
+        T s = b[k];
+        for(I l = 0; l < k; l++){
+            s = s - M[n*k + l] * b[l];
+        }
+        b[k] = s;
+    }
+    for(I k = n - 1; k >= 0; k--){
+        const T d = M[n*k + k];
+        if(d == T(0)){
+            b[k] = 0;
+            continue;
+        }
+        T s = T(b[k] / d);
+        for(I i = k + 1; i < n; i++){
+            s = s - conjugate(M[n*i + k]) * b[i];
+        }
+        b[k] = s;
+    }
+}
+
+
+/*
+ * Number of entries of work needed by constrained_fit_errors
+ */
+template <class I>
+I constrained_fit_work_size(const I n_dim)
+{
+    return n_dim * (n_dim + 3);
+}
+
+
+/*
+ * Fit the n values z[0:n], at rows cols[0:n] of B, by a combination of
+ * the columns of B, exactly at row `row`, and replace each z by the
+ * relative error of the fit there
+ *
+ *   min_c  sum_jj |z[jj] - B[cols[jj],:] c|^2
+ *   such that  B[row,:] c = z_row
+ *
+ * where z_row is the sum of the z[jj] with cols[jj] == row.  B is
+ * (*, n_dim), row-major.
+ *
+ * On return z[jj] = |z[jj] - B[cols[jj],:] c| / |z[jj]|, and 0 where
+ * cols[jj] == row or z[jj] == 0.
+ *
+ * The constraint is eliminated through the largest entry p of
+ * B[row,:]: c[p] is expressed by the other unknowns, which leaves an
+ * unconstrained problem in n_dim unknowns whose column p is zero.  It
+ * is solved through its normal equations by hermitian_lsq_solve, with
+ * tol the relative pivot tolerance.  If B[row,:] is zero the fit is
+ * unconstrained.
+ *
+ * work holds constrained_fit_work_size(n_dim) entries; it is not used,
+ * and may be null, when K > 0.
+ */
+template <int K, class I, class T>
+void constrained_fit_errors(const I row,
+                            const I n,
+                            const I cols[],
+                                  T z[],
+                            const T B[],
+                            const I n_dim,
+                            const T tol,
+                                  T work[])
+{
+    const I k = K > 0 ? K : n_dim;
+
+    // for K > 0 the arrays are local, so that once the loops are
+    // unrolled they live in registers
+    T local[K > 0 ? K * (K + 3) : 1];
+    if(K > 0){
+        work = local;
+    }
+    T * M   = work;         // normal equations, k x k
+    T * c   = M + k*k;      // right-hand side, then the solution
+    T * r   = c + k;        // B[row,q] / B[row,p]
+    T * bj  = r + k;        // a row of B with the constraint eliminated
+
+    const T * b_row = B + (npy_intp)k * row;
+    T z_row = 0;
+    for(I jj = 0; jj < n; jj++){
+        if(cols[jj] == row){
+            z_row += z[jj];
+        }
+    }
+
+    I p = -1;
+    double b_max = 0;
+    for(I q = 0; q < k; q++){
+        const double m = real_part(magnitude(b_row[q]));
+        if(m > b_max){
+            b_max = m;
+            p = q;
+        }
+    }
+    T c0 = 0;
+    for(I q = 0; q < k; q++){
+        r[q] = 0;
+    }
+    if(p >= 0){
+        c0 = T(z_row / b_row[p]);
+        for(I q = 0; q < k; q++){
+            if(q != p){
+                r[q] = T(b_row[q] / b_row[p]);
+            }
+        }
+    }
+
+    for(I q = 0; q < k*k; q++){
+        M[q] = 0;
+    }
+    for(I q = 0; q < k; q++){
+        c[q] = 0;
+    }
+    for(I jj = 0; jj < n; jj++){
+        const T * b = B + (npy_intp)k * cols[jj];
+        const T bp = p >= 0 ? b[p] : T(0);
+        for(I q = 0; q < k; q++){
+            bj[q] = (q == p) ? T(0) : T(b[q] - bp * r[q]);
+        }
+        const T zj = T(z[jj] - bp * c0);
+        for(I a = 0; a < k; a++){
+            const T ba = conjugate(bj[a]);
+            c[a] += T(ba * zj);
+            for(I q = a; q < k; q++){
+                M[k*a + q] += T(ba * bj[q]);
+            }
+        }
+    }
+    for(I a = 1; a < k; a++){
+        for(I q = 0; q < a; q++){
+            M[k*a + q] = conjugate(M[k*q + a]);
+        }
+    }
+
+    hermitian_lsq_solve<K>(k, M, c, tol);
+
+    // back to the coefficients of the columns of B
+    if(p >= 0){
+        T cp = c0;
+        for(I q = 0; q < k; q++){
+            cp = cp - r[q] * c[q];
+        }
+        // not c[p] = cp: a constant index keeps c in registers
+        for(I q = 0; q < k; q++){
+            if(q == p){
+                c[q] = cp;
+            }
+        }
+    }
+
+    for(I jj = 0; jj < n; jj++){
+        const T zj = z[jj];
+        if(cols[jj] == row || zj == T(0)){
+            z[jj] = 0;
+            continue;
+        }
+        const T * b = B + (npy_intp)k * cols[jj];
+        T fit = 0;
+        for(I q = 0; q < k; q++){
+            fit += T(b[q] * c[q]);
+        }
+        z[jj] = T(magnitude(T(zj - fit)) / magnitude(zj));
+    }
+}
+
+
+/*
+ * constrained_fit_errors for every row of CSR matrix S, in parallel
+ *
+ * For K = 0 each thread allocates one work array when it starts and
+ * uses it for all of its rows.
+ */
+template <int K, class I, class T>
+void constrained_fit_rows(const I n_row,
+                          const I Sp[],
+                          const I Sj[],
+                                T Sx[],
+                          const T B[],
+                          const I n_dim,
+                          const T tol)
+{
+    #pragma omp parallel if(Sp[n_row] > parallel_threshold)
+    {
+        std::vector<T> general(K > 0 ? 0 : constrained_fit_work_size(n_dim));
+        T * work = general.data();
+
+        #pragma omp for schedule(dynamic, 64)
+        for(I i = 0; i < n_row; i++){
+            constrained_fit_errors<K>(i, (I)(Sp[i+1] - Sp[i]), Sj + Sp[i], Sx + Sp[i],
+                                      B, n_dim, tol, work);
+        }
+    }
+}
+
+#endif
@@ -19,6 +19,12 @@ class complex_wrapper : public npy_type {
             npy_type::real = r;
             npy_type::imag = i;
         }
+        /* Conversion between precisions, e.g. npy_cfloat -> npy_cdouble */
+        template <class c_type2, class npy_type2>
+        explicit complex_wrapper( const complex_wrapper<c_type2,npy_type2>& B ){
+            npy_type::real = B.real;
+            npy_type::imag = B.imag;
+        }
         /* Conversion */
         operator bool() const {
             if (npy_type::real == 0 && npy_type::imag == 0) {
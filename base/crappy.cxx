@@ -49,6 +49,11 @@ static const int supported_T_typenums[] = {NPY_BOOL,
                                            NPY_CFLOAT, NPY_CDOUBLE, NPY_CLONGDOUBLE};
 static const int n_supported_T_typenums = sizeof(supported_T_typenums) / sizeof(int);
 
+/* Storage types of 'S' arrays, narrowest first */
+static const int supported_S_typenums[] = {NPY_FLOAT, NPY_DOUBLE,
+                                           NPY_CFLOAT, NPY_CDOUBLE};
+static const int n_supported_S_typenums = sizeof(supported_S_typenums) / sizeof(int);
+
 static PyObject *array_from_std_vector_and_free(int typenum, void *p);
 static void *allocate_std_vector_typenum(int typenum);
 static void free_std_vector_typenum(int typenum, void *p);
@@ -57,8 +62,8 @@ static PyObject *c_array_from_object(PyObject *obj, int typenum, int is_output);
 /*
  * Call a thunk function, dealing with input and output arrays.
  *
- * Resolves the templated <integer> and <data> dtypes from the `args` argument
- * list.
+ * Resolves the templated <integer>, <data>, <storage> and <pointer> dtypes
+ * from the `args` argument list.
  *
  * Parameters
  * ----------
@@ -72,14 +77,30 @@ static PyObject *c_array_from_object(PyObject *obj, int typenum, int is_output);
  *     'I': <integer> array
  *     't': <data> scalar
  *     'T': <data> array
+ *     'S': <storage> array, resolved apart from <data> so that a matrix
+ *          kept in a narrow type is not cast to the vectors' type
+ *     'P': <pointer> array (CSR row pointer), an integer type resolved apart
+ *          from <integer> so that e.g. int64 Ap can go with int32 Aj
  *     'V': std::vector<integer>
  *     'W': std::vector<data>
  *     'B': npy_bool array
+ *     'C': char array, passed as a uint8 array: a byte buffer (e.g. a
+ *          mapped file) or a NUL-terminated file name
  *     '*': indicates that the next argument is an output argument
- * thunk : Py_ssize_t thunk(int I_typenum, int T_typenum, void **)
+ * thunk : Py_ssize_t thunk(int I_typenum, int T_typenum, int S_typenum,
+ *                       int P_typenum, void **)
  *     Thunk function to call. It is passed a void** array of pointers to
  *     arguments, constructed according to `spec`. The types of data pointed
- *     to by each element agree with I_typenum and T_typenum, or are bools.
+ *     to by each element agree with I_typenum, T_typenum, S_typenum and
+ *     P_typenum, or are bools.
+ *
+ *     When 'S' is in the spec, <data> is widened if needed so that <storage>
+ *     casts to it safely (e.g. float32 storage with float64 vectors keeps
+ *     both; float64 storage with float32 vectors uses float64 vectors).
+ *
+ *     When all 'P' arrays are inputs and resolve to int64, they are narrowed
+ *     to int32 if their last entry (nnz, for a row pointer) fits.  This
+ *     copies only the row pointers and lets the int32 instantiation run.
  * args
  *     Python tuple containing unprocessed arguments.
  *
@@ -98,9 +119,15 @@ call_thunk(char ret_spec, const char *spec, thunk_t *thunk, PyObject *args)
     PyObject *return_value = NULL;
     int I_typenum = NPY_INT32;
     int T_typenum = -1;
+    int S_typenum = -1;
+    int P_typenum = NPY_INT32;
     int VW_count = 0;
     int I_in_arglist = 0;
     int T_in_arglist = 0;
+    int S_in_arglist = 0;
+    int P_in_arglist = 0;
+    int P_is_output = 0;
+    int P_narrowed = 0;
     int next_is_output = 0;
     int j, k, arg_j;
     const char *p;
@@ -157,13 +184,16 @@ call_thunk(char ret_spec, const char *spec, thunk_t *thunk, PyObject *args)
             arg_arrays[j] = arg;
             continue;
         case 't':
-            /* Double scalars */
+            /* Data scalars: cast to <data> below, do not resolve it */
             arg = PyTuple_GetItem(args, arg_j);
             if (arg == NULL) {
                 goto fail;
             }
-            Py_INCREF(arg);
-            arg_arrays[j] = arg;
+            arg_arrays[j] = c_array_from_object(arg, -1, 0);
+            if (arg_arrays[j] == NULL) {
+                goto fail;
+            }
+            T_in_arglist = 1;
             continue;
         case 'I':
             /* Integer arrays */
@@ -179,6 +209,21 @@ call_thunk(char ret_spec, const char *spec, thunk_t *thunk, PyObject *args)
             cur_typenum = T_typenum;
             T_in_arglist = 1;
             break;
+        case 'P':
+            /* Row pointer arrays */
+            supported_typenums = supported_I_typenums;
+            n_supported_typenums = n_supported_I_typenums;
+            cur_typenum = P_typenum;
+            P_in_arglist = 1;
+            P_is_output |= is_output[j];
+            break;
+        case 'S':
+            /* Storage arrays */
+            supported_typenums = supported_S_typenums;
+            n_supported_typenums = n_supported_S_typenums;
+            cur_typenum = S_typenum;
+            S_in_arglist = 1;
+            break;
         case 'B':
             /* Boolean arrays */
             arg = PyTuple_GetItem(args, arg_j);
@@ -190,6 +235,17 @@ call_thunk(char ret_spec, const char *spec, thunk_t *thunk, PyObject *args)
                 goto fail;
             }
             continue;
+        case 'C':
+            /* Character arrays */
+            arg = PyTuple_GetItem(args, arg_j);
+            if (arg == NULL) {
+                goto fail;
+            }
+            arg_arrays[j] = c_array_from_object(arg, NPY_UBYTE, is_output[j]);
+            if (arg_arrays[j] == NULL) {
+                goto fail;
+            }
+            continue;
         case 'V':
             /* std::vector integer output array */
             I_in_arglist = 1;
@@ -231,6 +287,12 @@ call_thunk(char ret_spec, const char *spec, thunk_t *thunk, PyObject *args)
         if (*p == 'I') {
             I_typenum = cur_typenum;
         }
+        else if (*p == 'S') {
+            S_typenum = cur_typenum;
+        }
+        else if (*p == 'P') {
+            P_typenum = cur_typenum;
+        }
         else {
             T_typenum = cur_typenum;
         }
@@ -241,8 +303,64 @@ call_thunk(char ret_spec, const char *spec, thunk_t *thunk, PyObject *args)
         return NULL;
     }
 
+    if (S_in_arglist && S_typenum != -1) {
+        /* Widen <data> to the narrowest type <storage> casts to */
+        int widened = -1;
+        for (k = 0; k < n_supported_S_typenums; ++k) {
+            if (PyArray_CanCastSafely(S_typenum, supported_S_typenums[k]) &&
+                (T_typenum == -1 ||
+                 PyArray_CanCastSafely(T_typenum, supported_S_typenums[k]))) {
+                widened = supported_S_typenums[k];
+                break;
+            }
+        }
+        T_typenum = widened;
+    }
+
+    if (P_in_arglist && !P_is_output &&
+            PyArray_EquivTypenums(P_typenum, NPY_INT64)) {
+        /* Narrow int64 row pointers whose values fit in int32 */
+        int fits = 1;
+        j = 0;
+        for (p = spec; *p != '\0' && fits; ++p, ++j) {
+            PyArrayObject *arr;
+            PyObject *last;
+            npy_intp size;
+            long long value;
+
+            if (*p == '*') {
+                --j;
+                continue;
+            }
+            if (*p != 'P') {
+                continue;
+            }
+
+            arr = (PyArrayObject *) arg_arrays[j];
+            size = PyArray_SIZE(arr);
+            if (size == 0 || PyArray_NDIM(arr) != 1) {
+                continue;
+            }
+            last = PyArray_GETITEM(arr, (char *)PyArray_GETPTR1(arr, size - 1));
+            if (last == NULL) {
+                goto fail;
+            }
+            value = PyLong_AsLongLong(last);
+            Py_DECREF(last);
+            if (PyErr_Occurred()) {
+                goto fail;
+            }
+            fits = (value >= 0 && value == (npy_int32)value);
+        }
+        if (fits) {
+            P_typenum = NPY_INT32;
+            P_narrowed = 1;
+        }
+    }
+
     if ((I_in_arglist && I_typenum == -1) ||
-        (T_in_arglist && T_typenum == -1)) {
+        (T_in_arglist && T_typenum == -1) ||
+        (S_in_arglist && S_typenum == -1)) {
         PyErr_SetString(PyExc_RuntimeError,
                         "internal error: failed to resolve data types");
         goto fail;
@@ -286,8 +404,20 @@ call_thunk(char ret_spec, const char *spec, thunk_t *thunk, PyObject *args)
             }
             continue;
         }
-        else if (*p == 'B') {
-            /* Boolean arrays already cast */
+        else if (*p == 'B' || *p == 'C') {
+            /* Boolean and character arrays already cast */
+        }
+        else if (*p == 't') {
+            /* Data scalars: a Python float or complex may narrow */
+            arg = arg_arrays[j];
+            arg_arrays[j] = PyArray_FROM_OTF(arg, T_typenum,
+                                             NPY_ARRAY_C_CONTIGUOUS|NPY_ARRAY_FORCECAST);
+            Py_DECREF(arg);
+            if (arg_arrays[j] == NULL) {
+                goto fail;
+            }
+            arg_list[j] = PyArray_DATA((PyArrayObject *) arg_arrays[j]);
+            continue;
         }
         else if (*p == 'V') {
             arg_list[j] = allocate_std_vector_typenum(I_typenum);
@@ -304,14 +434,32 @@ call_thunk(char ret_spec, const char *spec, thunk_t *thunk, PyObject *args)
             continue;
         }
         else {
-            cur_typenum = (*p == 'I' || *p == 'i') ? I_typenum : T_typenum;
+            if (*p == 'I') {
+                cur_typenum = I_typenum;
+            }
+            else if (*p == 'P') {
+                cur_typenum = P_typenum;
+            }
+            else if (*p == 'S') {
+                cur_typenum = S_typenum;
+            }
+            else {
+                cur_typenum = T_typenum;
+            }
 
             /* Cast if necessary */
             arg = arg_arrays[j];
             if (!PyArray_EquivTypenums(PyArray_DESCR((PyArrayObject *) arg)->type_num,
                                        cur_typenum))
             {
-                arg_arrays[j] = c_array_from_object(arg, cur_typenum, is_output[j]);
+                if (*p == 'P' && P_narrowed) {
+                    /* Checked above that the values fit */
+                    arg_arrays[j] = PyArray_FROM_OTF(arg, cur_typenum,
+                                                     NPY_ARRAY_C_CONTIGUOUS|NPY_ARRAY_FORCECAST);
+                }
+                else {
+                    arg_arrays[j] = c_array_from_object(arg, cur_typenum, is_output[j]);
+                }
                 Py_DECREF(arg);
                 if (arg_arrays[j] == NULL) {
                     goto fail;
@@ -337,12 +485,20 @@ call_thunk(char ret_spec, const char *spec, thunk_t *thunk, PyObject *args)
         NPY_BEGIN_THREADS;
     }
     try {
-        ret = thunk(I_typenum, T_typenum, arg_list);
+        ret = thunk(I_typenum, T_typenum, S_typenum, P_typenum, arg_list);
         NPY_END_THREADS;
     } catch (const std::bad_alloc &e) {
         NPY_END_THREADS;
         PyErr_SetString(PyExc_MemoryError, e.what());
         goto fail;
+    } catch (const std::invalid_argument &e) {
+        NPY_END_THREADS;
+        PyErr_SetString(PyExc_ValueError, e.what());
+        goto fail;
+    } catch (const std::overflow_error &e) {
+        NPY_END_THREADS;
+        PyErr_SetString(PyExc_OverflowError, e.what());
+        goto fail;
     } catch (const std::exception &e) {
         NPY_END_THREADS;
         PyErr_SetString(PyExc_RuntimeError, e.what());
@@ -422,13 +578,20 @@ fail:
      */
     for (j = 0; j < MAX_ARGS; ++j) {
         Py_XDECREF(arg_arrays[j]);
-        if (spec[j] == 'i' && arg_list[j] != NULL) {
+    }
+    /* arg_list is indexed by argument, spec also holds the '*' markers */
+    j = 0;
+    for (p = spec; *p != '\0' && j < MAX_ARGS; ++p, ++j) {
+        if (*p == '*') {
+            --j;
+        }
+        else if (*p == 'i' && arg_list[j] != NULL) {
             std::free(arg_list[j]);
         }
-        else if (spec[j] == 'V' && arg_list[j] != NULL) {
+        else if (*p == 'V' && arg_list[j] != NULL) {
             free_std_vector_typenum(I_typenum, arg_list[j]);
         }
-        else if (spec[j] == 'W' && arg_list[j] != NULL) {
+        else if (*p == 'W' && arg_list[j] != NULL) {
             free_std_vector_typenum(T_typenum, arg_list[j]);
         }
     }
@@ -504,6 +667,26 @@ static void free_std_vector_typenum(int typenum, void *p)
 #undef PROCESS
 }
 
+/*
+ * memcpy into a freshly allocated array with the copy split over the
+ * OpenMP threads like a schedule(static) kernel loop, so that each page
+ * of dst is first touched by, and hence placed on the NUMA node of, the
+ * thread that will process it rather than all on the calling thread's
+ * node.
+ */
+static void copy_first_touch(void *dst, const void *src, size_t nbytes)
+{
+    const size_t chunk = 1 << 16;
+    const npy_intp n_chunks = (npy_intp)((nbytes + chunk - 1) / chunk);
+
+    #pragma omp parallel for schedule(static) if(n_chunks > 16) // constant is arbitrary
+    for (npy_intp k = 0; k < n_chunks; k++) {
+        const size_t offset = (size_t)k * chunk;
+        const size_t len = (nbytes - offset < chunk) ? nbytes - offset : chunk;
+        memcpy((char *)dst + offset, (const char *)src + offset, len);
+    }
+}
+
 static PyObject *array_from_std_vector_and_free(int typenum, void *p)
 {
 #define PROCESS(ntype, ctype)                                   \
@@ -512,8 +695,8 @@ static PyObject *array_from_std_vector_and_free(int typenum, void *p)
         npy_intp length = v->size();                            \
         PyObject *obj = PyArray_SimpleNew(1, &length, typenum); \
         if (length > 0) {                                       \
-            memcpy(PyArray_DATA((PyArrayObject *) obj), &((*v)[0]),               \
-                   sizeof(ctype)*length);                       \
+            copy_first_touch(PyArray_DATA((PyArrayObject *) obj), \
+                             &((*v)[0]), sizeof(ctype)*length); \
         }                                                       \
         delete v;                                               \
         return obj;                                             \
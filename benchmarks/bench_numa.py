@@ -0,0 +1,96 @@
+"""
+SpMV with the matrix on the nodes of the threads that read it, against
+interleaved and single-node placement
+
+csr_matvec_alpha_beta is timed on a random CSR matrix three ways:
+
+    first-touch  the arrays as numpy allocated them: filled by the
+                 main thread, so all on its node
+    interleaved  the same, with the process run under
+                 `numactl --interleave=all` (skipped without numactl)
+    local        after numa_bind_threads, csr_distribute and
+                 vector_distribute of y
+
+On a single-node machine there is nothing to place and the three
+agree; the script says so.  Run with OMP_NUM_THREADS set to the number
+of cores.
+
+    python benchmarks/bench_numa.py [n_row] [nnz per row] [repeats]
+"""
+from __future__ import division, print_function, absolute_import
+
+import os
+import sys
+import time
+import shutil
+import subprocess
+import numpy as np
+
+import crappy
+
+
+def random_csr(n, per_row, rng):
+    indptr = np.arange(0, n * per_row + 1, per_row, dtype=np.int32)
+    indices = rng.randint(0, n, size=n * per_row).astype(np.int32)
+    data = rng.rand(n * per_row)
+    return indptr, indices, data
+
+
+def time_matvec(indptr, indices, data, x, y, repeats):
+    n = len(y)
+    crappy.csr_matvec_alpha_beta(n, n, indptr, indices, data, 1.0, x, 0.0, y)
+    best = np.inf
+    for _ in range(repeats):
+        t = time.perf_counter()
+        crappy.csr_matvec_alpha_beta(n, n, indptr, indices, data, 1.0, x, 0.0, y)
+        best = min(best, time.perf_counter() - t)
+    return best
+
+
+def run(n, per_row, repeats, distribute):
+    rng = np.random.RandomState(0)
+    indptr, indices, data = random_csr(n, per_row, rng)
+    x = rng.rand(n)
+    y = np.zeros(n)
+    if distribute:
+        n_bound = crappy.numa_bind_threads()
+        n_pages = crappy.csr_distribute(n, n, indptr, indices, data)
+        n_pages += crappy.vector_distribute(n, y)
+        if n_pages == 0:
+            print('single NUMA node (or no OpenMP): nothing to place')
+        else:
+            print('%d threads pinned, %d pages local' % (n_bound, n_pages))
+    return time_matvec(indptr, indices, data, x, y, repeats)
+
+
+def main():
+    args = [a for a in sys.argv[1:] if a != '--child']
+    n = int(args[0]) if len(args) > 0 else 4000000
+    per_row = int(args[1]) if len(args) > 1 else 16
+    repeats = int(args[2]) if len(args) > 2 else 10
+
+    if '--child' in sys.argv:
+        print('%.6f' % run(n, per_row, repeats, False))
+        return
+
+    print('n_row = %d, nnz = %d, %s threads' %
+          (n, n * per_row, os.environ.get('OMP_NUM_THREADS', 'default')))
+    results = [('first-touch', run(n, per_row, repeats, False))]
+
+    numactl = shutil.which('numactl')
+    if numactl:
+        out = subprocess.check_output([numactl, '--interleave=all', sys.executable,
+                                       os.path.abspath(__file__), '--child',
+                                       str(n), str(per_row), str(repeats)])
+        results.append(('interleaved', float(out.split()[-1])))
+    else:
+        print('numactl not found: interleaved placement skipped')
+
+    results.append(('local', run(n, per_row, repeats, True)))
+    for name, t in results:
+        print('%-12s csr_matvec_alpha_beta %.2f ms  (%.2f GB/s)' %
+              (name, 1e3 * t, n * per_row * 12 / t * 1e-9))
+
+
+if __name__ == '__main__':
+    main()
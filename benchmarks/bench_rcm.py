@@ -0,0 +1,96 @@
+"""
+SpMV before and after a reverse Cuthill-McKee reordering
+
+A 2D Poisson matrix is scrambled by a random symmetric permutation,
+then reordered with csr_rcm and csr_permute.  csr_matvec is timed on
+both, and the bandwidth of each is reported: the reordered matrix
+reads x in a narrow window around each row, so most of its loads hit
+cache.
+
+    python benchmarks/bench_rcm.py [grid size] [repeats]
+"""
+from __future__ import division, print_function, absolute_import
+
+import sys
+import time
+import numpy as np
+
+import crappy
+
+
+def poisson2d(n):
+    """5-point Laplacian on an n x n grid, in CSR form"""
+    N = n * n
+    i = np.arange(N)
+    rows, cols = [i], [i]
+    for d, keep in [(1, i % n != n - 1), (-1, i % n != 0),
+                    (n, i < N - n), (-n, i >= n)]:
+        rows.append(i[keep])
+        cols.append(i[keep] + d)
+    rows = np.concatenate(rows)
+    cols = np.concatenate(cols)
+    data = np.where(rows == cols, 4.0, -1.0)
+
+    order = np.lexsort((cols, rows))
+    indptr = np.zeros(N + 1, dtype=np.int32)
+    np.cumsum(np.bincount(rows, minlength=N), out=indptr[1:])
+    return indptr, cols[order].astype(np.int32), data[order], N
+
+
+def permute(indptr, indices, data, N, perm):
+    Bp = np.empty_like(indptr)
+    Bj = np.empty_like(indices)
+    Bx = np.empty_like(data)
+    crappy.csr_permute(N, N, indptr, indices, data, perm, perm, Bp, Bj, Bx)
+    return Bp, Bj, Bx
+
+
+def bandwidth(indptr, indices):
+    rows = np.repeat(np.arange(len(indptr) - 1), np.diff(indptr))
+    return int(np.abs(indices - rows).max())
+
+
+def time_matvec(indptr, indices, data, N, repeats):
+    x = np.ones(N)
+    y = np.zeros(N)
+    crappy.csr_matvec(N, N, indptr, indices, data, x, y)
+    best = np.inf
+    for _ in range(repeats):
+        t = time.perf_counter()
+        crappy.csr_matvec(N, N, indptr, indices, data, x, y)
+        best = min(best, time.perf_counter() - t)
+    return best
+
+
+def main():
+    n = int(sys.argv[1]) if len(sys.argv) > 1 else 1000
+    repeats = int(sys.argv[2]) if len(sys.argv) > 2 else 20
+
+    Ap, Aj, Ax, N = poisson2d(n)
+    rng = np.random.RandomState(0)
+    scrambled = permute(Ap, Aj, Ax, N, rng.permutation(N).astype(np.int32))
+
+    t = time.perf_counter()
+    perm = np.empty(N, dtype=np.int32)
+    crappy.csr_rcm(N, scrambled[0], scrambled[1], perm)
+    t_rcm = time.perf_counter() - t
+    t = time.perf_counter()
+    reordered = permute(scrambled[0], scrambled[1], scrambled[2], N, perm)
+    t_permute = time.perf_counter() - t
+
+    x = rng.rand(N)
+    y0, y1 = np.zeros(N), np.zeros(N)
+    crappy.csr_matvec(N, N, scrambled[0], scrambled[1], scrambled[2], x, y0)
+    crappy.csr_matvec(N, N, reordered[0], reordered[1], reordered[2], x[perm], y1)
+    assert np.allclose(y0[perm], y1)
+
+    print('N = %d, nnz = %d' % (N, Ap[-1]))
+    print('csr_rcm %.3f s, csr_permute %.3f s' % (t_rcm, t_permute))
+    for name, (Bp, Bj, Bx) in [('scrambled', scrambled), ('reordered', reordered)]:
+        t = time_matvec(Bp, Bj, Bx, N, repeats)
+        print('%-10s bandwidth %8d  csr_matvec %.2f ms' %
+              (name, bandwidth(Bp, Bj), 1e3 * t))
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,145 @@
+"""
+Strength of connection against a serial reference
+
+classical_strength_of_connection and symmetric_strength_of_connection
+are run on an anisotropic 2D Poisson matrix and checked against a
+serial reference: pyamg's amg_core when pyamg is installed, and a
+vectorized numpy version of the same measures otherwise.  The kernels
+are also timed with OMP_NUM_THREADS=1, in a subprocess, for the
+parallel speedup.
+
+    python benchmarks/bench_strength.py [grid size] [theta] [repeats]
+"""
+from __future__ import division, print_function, absolute_import
+
+import os
+import sys
+import time
+import subprocess
+import numpy as np
+
+import crappy
+
+try:
+    from pyamg import amg_core
+except ImportError:
+    amg_core = None
+
+
+def anisotropic_poisson2d(n, eps=0.01):
+    """-u_xx - eps*u_yy on an n x n grid, in CSR form"""
+    N = n * n
+    i = np.arange(N)
+    rows, cols, vals = [i], [i], [np.full(N, 2 + 2 * eps)]
+    for d, v, keep in [(1, -1.0, i % n != n - 1), (-1, -1.0, i % n != 0),
+                       (n, -eps, i < N - n), (-n, -eps, i >= n)]:
+        rows.append(i[keep])
+        cols.append(i[keep] + d)
+        vals.append(np.full(keep.sum(), v))
+    rows = np.concatenate(rows)
+    cols = np.concatenate(cols)
+    vals = np.concatenate(vals)
+
+    order = np.lexsort((cols, rows))
+    indptr = np.zeros(N + 1, dtype=np.int32)
+    np.cumsum(np.bincount(rows, minlength=N), out=indptr[1:])
+    return indptr, cols[order].astype(np.int32), vals[order], N
+
+
+def _filter(indptr, indices, data, keep):
+    rows = np.repeat(np.arange(len(indptr) - 1), np.diff(indptr))
+    Sp = np.zeros_like(indptr)
+    np.cumsum(np.bincount(rows[keep], minlength=len(indptr) - 1), out=Sp[1:])
+    return Sp, indices[keep], data[keep]
+
+
+def classical_reference(N, theta, indptr, indices, data):
+    rows = np.repeat(np.arange(N), np.diff(indptr))
+    diag = indices == rows
+    m = np.where(diag, 0, np.abs(data))
+    max_offdiag = np.zeros(N, dtype=m.dtype)
+    np.maximum.at(max_offdiag, rows, m)
+    keep = diag | ((data != 0) & ~(np.abs(data) < theta * max_offdiag[rows]))
+    return _filter(indptr, indices, data, keep)
+
+
+def symmetric_reference(N, theta, indptr, indices, data):
+    rows = np.repeat(np.arange(N), np.diff(indptr))
+    diag = indices == rows
+    d = np.zeros(N, dtype=data.dtype)
+    np.add.at(d, rows[diag], data[diag])
+    d = np.abs(d)
+    m = np.abs(data)
+    keep = diag | ~(m * m < (theta * theta * d[rows]) * d[indices])
+    return _filter(indptr, indices, data, keep)
+
+
+def run_crappy(name, N, theta, indptr, indices, data):
+    Sp = np.empty_like(indptr)
+    Sj = np.empty_like(indices)
+    Sx = np.empty_like(data)
+    nnz = getattr(crappy, name)(N, theta, indptr, indices, data, Sp, Sj, Sx)
+    return Sp, Sj[:nnz], Sx[:nnz]
+
+
+def run_pyamg(name, N, theta, indptr, indices, data):
+    Sp = np.empty_like(indptr)
+    Sj = np.empty_like(indices)
+    Sx = np.empty_like(data)
+    if name == 'classical_strength_of_connection':
+        amg_core.classical_strength_of_connection_abs(N, theta, indptr, indices, data, Sp, Sj, Sx)
+    else:
+        amg_core.symmetric_strength_of_connection(N, theta, indptr, indices, data, Sp, Sj, Sx)
+    return Sp, Sj[:Sp[-1]], Sx[:Sp[-1]]
+
+
+def best_time(f, repeats):
+    best = np.inf
+    for _ in range(repeats):
+        t = time.perf_counter()
+        f()
+        best = min(best, time.perf_counter() - t)
+    return best
+
+
+def main():
+    args = [a for a in sys.argv[1:] if a != '--child']
+    n = int(args[0]) if len(args) > 0 else 1000
+    theta = float(args[1]) if len(args) > 1 else 0.25
+    repeats = int(args[2]) if len(args) > 2 else 10
+
+    indptr, indices, data, N = anisotropic_poisson2d(n)
+    names = ['classical_strength_of_connection', 'symmetric_strength_of_connection']
+
+    if '--child' in sys.argv:
+        for name in names:
+            print('%.6f' % best_time(lambda: run_crappy(name, N, theta, indptr, indices, data), repeats))
+        return
+
+    env = dict(os.environ, OMP_NUM_THREADS='1')
+    out = subprocess.check_output([sys.executable, os.path.abspath(__file__), '--child',
+                                   str(n), str(theta), str(repeats)], env=env)
+    serial = [float(t) for t in out.split()]
+
+    print('N = %d, nnz = %d, theta = %g, %s threads' %
+          (N, indptr[-1], theta, os.environ.get('OMP_NUM_THREADS', 'default')))
+    numpy_refs = {'classical_strength_of_connection': classical_reference,
+                  'symmetric_strength_of_connection': symmetric_reference}
+    references = [('numpy', lambda name, *a: numpy_refs[name](*a))]
+    if amg_core is not None:
+        references.insert(0, ('pyamg', run_pyamg))
+
+    for name, t_serial in zip(names, serial):
+        S = run_crappy(name, N, theta, indptr, indices, data)
+        t = best_time(lambda: run_crappy(name, N, theta, indptr, indices, data), repeats)
+        print('%s: nnz(S) = %d' % (name, S[0][-1]))
+        print('    crappy      %8.2f ms  (1 thread %.2f ms)' % (1e3 * t, 1e3 * t_serial))
+        for ref_name, ref in references:
+            R = ref(name, N, theta, indptr, indices, data)
+            assert all(np.array_equal(a, b) for a, b in zip(S, R)), ref_name
+            t_ref = best_time(lambda: ref(name, N, theta, indptr, indices, data), repeats)
+            print('    %-10s  %8.2f ms  (same S, %.1fx)' % (ref_name, 1e3 * t_ref, t_ref / t))
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,201 @@
+"""
+Binary CSR container with zero-copy loading
+
+The format is described in templates/csrbin_ops.h.  `load` maps the sections
+with numpy.memmap; the arrays it returns can be passed straight to the
+crappy kernels, which read them in place (call_thunk only copies an
+array whose dtype differs from the one resolved for the call).  Worker
+processes that load the same file share its pages through the page
+cache.
+"""
+from __future__ import division, print_function, absolute_import
+
+import os
+import struct
+import numpy as np
+
+import crappy
+
+MAGIC = b'CRPYCSR\x00'
+VERSION = 1
+ALIGNMENT = 4096
+CANONICAL = 1
+
+# see csrbin_header in templates/csrbin_ops.h
+HEADER = struct.Struct('<8sII8s8s8sqqqII3Q3Q3QQ')
+HEADER_CHECKSUM_OFFSET = HEADER.size - 8
+
+CHUNK_WORDS = 1 << 22
+
+
+def _dtype_str(dtype):
+    """numpy type string in little-endian order, as the C++ side writes it"""
+    return np.dtype(dtype).newbyteorder('<').str
+
+
+def checksum(buf):
+    """sum_k (2k+1) * w_k mod 2^64 over the little-endian 64-bit words w_k
+    of buf, zero-padded to a multiple of 8 bytes"""
+    buf = np.frombuffer(buf, dtype=np.uint8)
+    n_words = len(buf) // 8
+    words = buf[:8 * n_words].view('<u8')
+    total = np.uint64(0)
+    with np.errstate(over='ignore'):
+        for k0 in range(0, n_words, CHUNK_WORDS):
+            w = words[k0:k0 + CHUNK_WORDS]
+            weights = 2 * np.arange(k0, k0 + len(w), dtype=np.uint64) + np.uint64(1)
+            total += np.sum(w * weights, dtype=np.uint64)
+        if len(buf) % 8:
+            tail = np.zeros(8, dtype=np.uint8)
+            tail[:len(buf) % 8] = buf[8 * n_words:]
+            total += tail.view('<u8')[0] * np.uint64(2 * n_words + 1)
+    return int(total)
+
+
+def _has_canonical_format(indptr, indices):
+    if len(indices) < 2:
+        return True
+    increasing = indices[1:] > indices[:-1]
+    # positions where a new row starts need not increase
+    starts = indptr[1:-1]
+    starts = starts[(starts > 0) & (starts < len(indices))]
+    increasing[starts - 1] = True
+    return bool(np.all(increasing))
+
+
+def save(filename, indptr, indices, data, shape):
+    """Write a CSR matrix (indptr, indices, data) of the given shape
+
+    indptr is stored as int32 when nnz fits, so that loading does not
+    trigger the int64 -> int32 row pointer narrowing in call_thunk,
+    which would copy it.
+    """
+    indptr = np.ascontiguousarray(indptr)
+    indices = np.ascontiguousarray(indices)
+    data = np.ascontiguousarray(data)
+    n_row, n_col = shape
+    nnz = int(indptr[-1])
+
+    if len(indptr) != n_row + 1 or len(indices) < nnz or len(data) < nnz:
+        raise ValueError('inconsistent CSR arrays')
+    if indptr.dtype.kind != 'i' or indices.dtype.kind != 'i':
+        raise ValueError('indptr and indices must be signed integer arrays')
+    if indices.dtype == np.int32 and nnz <= np.iinfo(np.int32).max:
+        indptr = indptr.astype(np.int32, copy=False)
+
+    sections = [indptr.astype(indptr.dtype.newbyteorder('<'), copy=False),
+                indices[:nnz].astype(indices.dtype.newbyteorder('<'), copy=False),
+                data[:nnz].astype(data.dtype.newbyteorder('<'), copy=False)]
+
+    offsets = []
+    offset = HEADER.size
+    for s in sections:
+        offset = (offset + ALIGNMENT - 1) // ALIGNMENT * ALIGNMENT
+        offsets.append(offset)
+        offset += s.nbytes
+
+    flags = CANONICAL if _has_canonical_format(indptr, indices) else 0
+    fields = [MAGIC, VERSION, HEADER.size,
+              _dtype_str(indptr.dtype).encode('ascii'),
+              _dtype_str(indices.dtype).encode('ascii'),
+              _dtype_str(data.dtype).encode('ascii'),
+              n_row, n_col, nnz, flags, 0] + \
+        offsets + [s.nbytes for s in sections] + \
+        [checksum(s.view(np.uint8).ravel()) for s in sections]
+    header = HEADER.pack(*(fields + [0]))
+    header = HEADER.pack(*(fields + [checksum(header[:HEADER_CHECKSUM_OFFSET])]))
+
+    with open(filename, 'wb') as f:
+        f.write(header)
+        pos = HEADER.size
+        for s, off in zip(sections, offsets):
+            f.write(b'\x00' * (off - pos))
+            s.tofile(f)
+            pos = off + s.nbytes
+            pad = (8 - pos % 8) % 8
+            f.write(b'\x00' * pad)
+            pos += pad
+
+
+def _read_header(filename):
+    """Read and check the header; returns its fields and the three
+    section dtype strings"""
+    with open(filename, 'rb') as f:
+        header = f.read(HEADER.size)
+    if len(header) < HEADER.size:
+        raise ValueError('not a binary CSR file')
+
+    fields = HEADER.unpack(header)
+    magic, version, header_size = fields[0:3]
+    dtypes = [d.rstrip(b'\x00').decode('ascii') for d in fields[3:6]]
+
+    if magic != MAGIC:
+        raise ValueError('not a binary CSR file')
+    if version != VERSION or header_size != HEADER.size or \
+            fields[20] != checksum(header[:HEADER_CHECKSUM_OFFSET]):
+        raise ValueError('unsupported or corrupt binary CSR header')
+    return fields, dtypes
+
+
+def load(filename, mode='r', verify=False):
+    """Map a binary CSR file
+
+    Returns (indptr, indices, data, shape, canonical), with the arrays as
+    numpy.memmap views of the file.  Use mode='c' (copy-on-write) or 'r+'
+    to pass them to kernels that modify their arguments in place.  With
+    verify set the section checksums are checked, which reads the whole
+    file once.
+    """
+    fields, dtypes = _read_header(filename)
+    n_row, n_col, nnz, flags = fields[6:10]
+    offsets, sizes, checksums = fields[11:14], fields[14:17], fields[17:20]
+
+    arrays = []
+    for dtype, offset, size, check in zip(dtypes, offsets, sizes, checksums):
+        dtype = np.dtype(dtype)
+        if size == 0:
+            # mmap cannot map an empty range
+            arrays.append(np.empty(0, dtype=dtype))
+            continue
+        arr = np.memmap(filename, dtype=dtype, mode=mode, offset=offset,
+                        shape=(size // dtype.itemsize,))
+        if verify and checksum(arr.view(np.uint8)) != check:
+            raise ValueError('binary CSR checksum mismatch')
+        arrays.append(arr)
+
+    indptr, indices, data = arrays
+    if len(indptr) != n_row + 1 or len(indices) != nnz or len(data) != nnz:
+        raise ValueError('truncated binary CSR file')
+
+    return indptr, indices, data, (n_row, n_col), bool(flags & CANONICAL)
+
+
+def matvec(filename, x, y, block_bytes=64 << 20):
+    """y += A*x for the matrix A in a binary CSR file, without loading A
+
+    A is streamed from disk in blocks of about block_bytes of indices and
+    values (csr_matvec_binary_stream in templates/csrbin.h), reading the
+    next block while the current one is multiplied.  x is cast to the
+    stored data type; y is updated in place.  Returns the timings of the
+    call in seconds, with overlap the fraction of the read time hidden
+    behind the multiply (zero when the multiply waited longer than the
+    reads took, e.g. with both threads on one core).
+    """
+    fields, dtypes = _read_header(filename)
+    n_row, n_col = fields[6:8]
+    dtype = np.dtype(dtypes[2])
+    x = np.ascontiguousarray(x, dtype=dtype)
+    if x.shape != (n_col,) or y.shape != (n_row,):
+        raise ValueError('dimension mismatch')
+
+    work = y if y.dtype == dtype and y.flags.c_contiguous else y.astype(dtype)
+    name = np.frombuffer(os.fsencode(filename) + b'\x00', dtype=np.uint8)
+    stats = np.zeros(6, dtype=np.int64)
+    crappy.csr_matvec_binary_stream(name, x, work, block_bytes, stats)
+    if work is not y:
+        y[...] = work
+
+    wall, read, compute, stall = stats[:4] * 1e-9
+    return {'wall': wall, 'read': read, 'compute': compute, 'stall': stall,
+            'bytes': int(stats[4]), 'blocks': int(stats[5]),
+            'overlap': max(0.0, 1 - stall / read) if read > 0 else 1.0}
@@ -43,9 +43,26 @@ T_TYPES = [
     ('NPY_CLONGDOUBLE', 'npy_clongdouble_wrapper'),
 ]
 
+# List of the supported (storage, data) typenum pairs for routines with 'S'
+# arrays, and the corresponding C++ types.  The storage type is never wider
+# than the data type, so e.g. float32 matrix values can be applied to
+# float64 vectors without up-casting the matrix.
+ST_TYPES = [
+    ('NPY_FLOAT', 'npy_float', 'NPY_FLOAT', 'npy_float'),
+    ('NPY_FLOAT', 'npy_float', 'NPY_DOUBLE', 'npy_double'),
+    ('NPY_FLOAT', 'npy_float', 'NPY_CFLOAT', 'npy_cfloat_wrapper'),
+    ('NPY_FLOAT', 'npy_float', 'NPY_CDOUBLE', 'npy_cdouble_wrapper'),
+    ('NPY_DOUBLE', 'npy_double', 'NPY_DOUBLE', 'npy_double'),
+    ('NPY_DOUBLE', 'npy_double', 'NPY_CDOUBLE', 'npy_cdouble_wrapper'),
+    ('NPY_CFLOAT', 'npy_cfloat_wrapper', 'NPY_CFLOAT', 'npy_cfloat_wrapper'),
+    ('NPY_CFLOAT', 'npy_cfloat_wrapper', 'NPY_CDOUBLE', 'npy_cdouble_wrapper'),
+    ('NPY_CDOUBLE', 'npy_cdouble_wrapper', 'NPY_CDOUBLE', 'npy_cdouble_wrapper'),
+]
+
 # Code templates
 THUNK_TEMPLATE = """
-static Py_ssize_t %(name)s_thunk(int I_typenum, int T_typenum, void **a)
+static Py_ssize_t %(name)s_thunk(int I_typenum, int T_typenum, int S_typenum,
+                                 int P_typenum, void **a)
 {
     %(thunk_content)s
 }
@@ -67,6 +84,22 @@ static int get_thunk_case(int I_typenum, int T_typenum)
 }
 """
 
+GET_THUNK_CASE_P_TEMPLATE = """
+static int get_thunk_case_P(int P_typenum)
+{
+    %(content)s;
+    return -1;
+}
+"""
+
+GET_THUNK_CASE_MIXED_TEMPLATE = """
+static int get_thunk_case_mixed(int I_typenum, int S_typenum, int T_typenum)
+{
+    %(content)s;
+    return -1;
+}
+"""
+
 AUTOGENERATE_TEMPLATE = """
 /* File autogenerated by generate_functions.py
  * Do not edit manually or check into VCS.
@@ -102,11 +135,11 @@ def get_thunk_type_set():
 
     Returns
     -------
-    i_types : list [(j, I_typenum, None, I_type, None), ...]
+    i_types : list [(j, I_typenum, None, I_type, None, None), ...]
          Pairing of index type numbers and the corresponding C++ types,
          and an unique index `j`. This is for routines that are parameterized
          only by I but not by T.
-    it_types : list [(j, I_typenum, T_typenum, I_type, T_type), ...]
+    it_types : list [(j, I_typenum, T_typenum, I_type, T_type, None), ...]
          Same as `i_types`, but for routines parameterized both by T and I.
     getter_code : str
          C++ code for a function that takes I_typenum, T_typenum and returns
@@ -129,7 +162,7 @@ def get_thunk_type_set():
         getter_code += piece % dict(I_typenum=I_typenum, j=j)
 
         if I_type is not -1:
-            i_types.append((j, I_typenum, None, I_type, None))
+            i_types.append((j, I_typenum, None, I_type, None, None))
         j += 1
 
         for T_typenum, T_type in T_TYPES:
@@ -138,9 +171,10 @@ def get_thunk_type_set():
             getter_code += piece % dict(T_typenum=T_typenum, j=j)
 
             if I_type is not -1:
-                it_types.append((j, I_typenum, T_typenum, I_type, T_type))
+                it_types.append((j, I_typenum, T_typenum, I_type, T_type,
+                                 None))
             else:
-                t_types.append((j, None, T_typenum, None, T_type))
+                t_types.append((j, None, T_typenum, None, T_type, None))
             j += 1
 
         getter_code += """
@@ -150,6 +184,71 @@ def get_thunk_type_set():
     return i_types, t_types, it_types, gtcstr
 
 
+def get_thunk_P_getter():
+    """
+    Get a getter routine for the row pointer ('P') index type.
+
+    Returns
+    -------
+    getter_code : str
+         C++ code for a function that takes P_typenum and returns its
+         position in I_TYPES, or -1 if no match was found.  Routines with
+         'P' arrays combine it with the `get_thunk_case` index.
+
+    """
+    getter_code = "    if (0) {}"
+    for p, (P_typenum, P_type) in enumerate(I_TYPES):
+        piece = """
+    else if (P_typenum == %(P_typenum)s) { return %(p)s; }"""
+        getter_code += piece % dict(P_typenum=P_typenum, p=p)
+
+    return GET_THUNK_CASE_P_TEMPLATE % dict(content=getter_code)
+
+
+def get_thunk_mixed_type_set():
+    """
+    Get a list of the index types crossed with the (storage, data) pairs
+    of ST_TYPES, plus a getter routine.  This is for routines with 'S'
+    arrays.
+
+    Returns
+    -------
+    ist_types : list [(j, I_typenum, T_typenum, I_type, T_type, S_type), ...]
+         Same as `it_types` of `get_thunk_type_set`, plus the storage type.
+    getter_code : str
+         C++ code for a function that takes I_typenum, S_typenum, T_typenum
+         and returns the unique index corresponding to the list, or -1 if no
+         match was found.
+
+    """
+    ist_types = []
+
+    j = 0
+
+    getter_code = "    if (0) {}"
+
+    for I_typenum, I_type in I_TYPES:
+        piece = """
+        else if (I_typenum == %(I_typenum)s) {
+            if (0) {}"""
+        getter_code += piece % dict(I_typenum=I_typenum)
+
+        for S_typenum, S_type, T_typenum, T_type in ST_TYPES:
+            piece = """
+            else if (S_typenum == %(S_typenum)s && T_typenum == %(T_typenum)s) { return %(j)s; }"""
+            getter_code += piece % dict(S_typenum=S_typenum,
+                                        T_typenum=T_typenum, j=j)
+
+            ist_types.append((j, I_typenum, T_typenum, I_type, T_type, S_type))
+            j += 1
+
+        getter_code += """
+        }"""
+
+    gtcstr = GET_THUNK_CASE_MIXED_TEMPLATE % dict(content=getter_code)
+    return ist_types, gtcstr
+
+
 def parse_routine(name, args, types):
     """
     Generate thunk and method code for a given routine.
@@ -163,6 +262,9 @@ def parse_routine(name, args, types):
         'i':  integer scalar
         'I':  integer array
         'T':  data array
+        'S':  storage array (see ST_TYPES)
+        'P':  row pointer array, an I_TYPES integer resolved apart from 'I'
+        'C':  char array (a byte buffer or a NUL-terminated file name)
         '*':  indicates that the next argument is an output argument
         'v':  void
 
@@ -176,7 +278,7 @@ def parse_routine(name, args, types):
     ret_spec = args[0]
     arg_spec = args[1:]
 
-    def get_arglist(I_type, T_type):
+    def get_arglist(I_type, T_type, S_type, P_type):
         """
         Generate argument list for calling the C++ function
         """
@@ -197,8 +299,14 @@ def parse_routine(name, args, types):
                 args.append("(%s*)a[%d]" % (const + I_type, j))
             elif t == 'T':
                 args.append("(%s*)a[%d]" % (const + T_type, j))
+            elif t == 'S':
+                args.append("(%s*)a[%d]" % (const + S_type, j))
+            elif t == 'P':
+                args.append("(%s*)a[%d]" % (const + P_type, j))
             elif t == 'B':
                 args.append("(npy_bool_wrapper*)a[%d]" % (j,))
+            elif t == 'C':
+                args.append("(%schar*)a[%d]" % (const, j))
             elif t == 'V':
                 if const:
                     raise ValueError("'V' argument must be an output arg")
@@ -214,14 +322,43 @@ def parse_routine(name, args, types):
 
     # Generate thunk code: a giant switch statement with different
     # type combinations inside.
-    thunk_content = """int j = get_thunk_case(I_typenum, T_typenum);
+    if 'S' in arg_spec:
+        thunk_content = """int j = get_thunk_case_mixed(I_typenum, S_typenum, T_typenum);"""
+    else:
+        thunk_content = """int j = get_thunk_case(I_typenum, T_typenum);"""
+
+    # Routines with 'P' arrays are instantiated for every row pointer type
+    # as well; the case index is extended by the P_typenum position.
+    if 'P' in arg_spec:
+        P_types = list(enumerate(I_TYPES))
+        thunk_content += """
+    int p = get_thunk_case_P(P_typenum);
+    j = (j == -1 || p == -1) ? -1 : %d * j + p;""" % (len(I_TYPES),)
+    else:
+        P_types = [(None, (None, None))]
+
+    thunk_content += """
     switch (j) {"""
-    for j, I_typenum, T_typenum, I_type, T_type in types:
-        arglist = get_arglist(I_type, T_type)
-        if T_type is None:
+    cases = []
+    for j, I_typenum, T_typenum, I_type, T_type, S_type in types:
+        for p, (P_typenum, P_type) in P_types:
+            if p is not None:
+                cases.append((len(I_TYPES) * j + p, I_typenum, T_typenum,
+                              I_type, T_type, S_type, P_type))
+            else:
+                cases.append((j, I_typenum, T_typenum,
+                              I_type, T_type, S_type, P_type))
+
+    for j, I_typenum, T_typenum, I_type, T_type, S_type, P_type in cases:
+        arglist = get_arglist(I_type, T_type, S_type, P_type)
+        if S_type is not None:
+            dispatch = "%s,%s,%s" % (I_type, S_type, T_type)
+        elif T_type is None:
             dispatch = "%s" % (I_type,)
         else:
             dispatch = "%s,%s" % (I_type, T_type)
+        if P_type is not None:
+            dispatch += ",%s" % (P_type,)
         if 'B' in arg_spec:
             dispatch += ",npy_bool_wrapper"
 
@@ -282,6 +419,8 @@ def main(hfilelist, hfiledir):
     docstrings = []
 
     i_types, t_types, it_types, getter_code = get_thunk_type_set()
+    ist_types, mixed_getter_code = get_thunk_mixed_type_set()
+    P_getter_code = get_thunk_P_getter()
 
     # Generate *_impl.h for each header
     # Generate *.cxx for each header
@@ -305,10 +444,12 @@ def main(hfilelist, hfiledir):
                 name = func['func']
                 docstring = func['docstring']
                 args = func['spec']
-                if ('i' in args or 'I' in args) and\
+                if 'S' in args:
+                    thunk, method = parse_routine(name, args, ist_types)
+                elif ('i' in args or 'I' in args) and\
                         ('t' in args or 'T' in args):
                     thunk, method = parse_routine(name, args, it_types)
-                elif ('i' in args or 'I' in args):
+                elif ('i' in args or 'I' in args or 'P' in args):
                     thunk, method = parse_routine(name, args, i_types)
                 elif ('t' in args or 'T' in args):
                     thunk, method = parse_routine(name, args, t_types)
@@ -321,9 +462,17 @@ def main(hfilelist, hfiledir):
                 thunks.append(thunk)
                 methods.append(method)
 
+            # write only the getters the thunks call, since unused static
+            # functions are warned about
+            specs = [func['spec'][1:] for func in funcs]
             with open(dst, 'w') as f:
                 f.write(AUTOGENERATE_TEMPLATE)
-                f.write(getter_code)
+                if any('S' not in spec for spec in specs):
+                    f.write(getter_code)
+                if any('S' in spec for spec in specs):
+                    f.write(mixed_getter_code)
+                if any('P' in spec for spec in specs):
+                    f.write(P_getter_code)
                 for thunk in thunks:
                     f.write(thunk)
                 for method in methods:
@@ -0,0 +1,110 @@
+"""
+Matrix Market files to and from CSR arrays
+
+`mmread` maps the file and passes the mapped bytes to the parallel
+reader of templates/mmio.h, in the two passes it is split into: the
+first fills the row pointer and gives nnz, the second fills the column
+indices and values.  `mmwrite` calls the parallel writer.  Only
+coordinate (sparse) files are supported.
+"""
+from __future__ import division, print_function, absolute_import
+
+import os
+import mmap
+import numpy as np
+
+import crappy
+
+# field codes of mm_read_info
+FIELDS = ['real', 'integer', 'complex', 'pattern']
+SYMMETRIES = ['general', 'symmetric', 'skew-symmetric', 'hermitian']
+
+DTYPES = {'real': np.float64, 'integer': np.int64,
+          'complex': np.complex128, 'pattern': np.float64}
+
+
+class _Mapped(object):
+    """Read-only map of a whole file as a uint8 array, read front to back"""
+
+    def __init__(self, filename):
+        with open(filename, 'rb') as f:
+            self.n_bytes = os.fstat(f.fileno()).st_size
+            if self.n_bytes == 0:
+                raise ValueError('not a Matrix Market file')
+            self._map = mmap.mmap(f.fileno(), 0, access=mmap.ACCESS_READ)
+        if hasattr(self._map, 'madvise'):
+            self._map.madvise(mmap.MADV_SEQUENTIAL)
+        self.buf = np.frombuffer(self._map, dtype=np.uint8)
+
+    def __enter__(self):
+        return self
+
+    def __exit__(self, *exc):
+        # the map cannot be closed while an array still exports it
+        del self.buf
+        self._map.close()
+
+
+def _index_dtype(n_bytes):
+    # every entry line takes at least 4 bytes, so nnz < n_bytes
+    if n_bytes <= np.iinfo(np.int32).max:
+        return np.int32
+    return np.int64
+
+
+def info(filename):
+    """Size, number of stored entries, field and symmetry of a file
+
+    Returns ((n_row, n_col), entries, field, symmetry).  Symmetric files
+    store one triangle, so nnz of the matrix may be up to twice entries.
+    Only the header is read.
+    """
+    with _Mapped(filename) as f:
+        out = np.zeros(5, dtype=_index_dtype(f.n_bytes))
+        crappy.mm_read_info(f.n_bytes, f.buf, out)
+    n_row, n_col, entries, field, symmetry = [int(v) for v in out]
+    return (n_row, n_col), entries, FIELDS[field], SYMMETRIES[symmetry]
+
+
+def mmread(filename, dtype=None):
+    """Read a Matrix Market coordinate file into CSR arrays
+
+    Returns (indptr, indices, data, shape), in canonical format: column
+    indices sorted and duplicate entries summed.  Symmetric files are
+    expanded to the full matrix.  data is float64, int64 or complex128
+    according to the field of the file, unless dtype is given; a complex
+    file can only be read into a complex dtype.  The index arrays are
+    int32 unless the file is too large for nnz to fit.
+    """
+    with _Mapped(filename) as f:
+        index_dtype = _index_dtype(f.n_bytes)
+
+        out = np.zeros(5, dtype=index_dtype)
+        crappy.mm_read_info(f.n_bytes, f.buf, out)
+        n_row, n_col, field = int(out[0]), int(out[1]), FIELDS[out[3]]
+        if dtype is None:
+            dtype = DTYPES[field]
+
+        indptr = np.empty(n_row + 1, dtype=index_dtype)
+        nnz = crappy.mm_read_csr_pass1(f.n_bytes, f.buf, indptr)
+        indices = np.empty(nnz, dtype=index_dtype)
+        data = np.empty(nnz, dtype=dtype)
+        nnz = crappy.mm_read_csr_pass2(f.n_bytes, f.buf, indptr, indices, data)
+
+    if nnz < len(indices):
+        indices = indices[:nnz].copy()
+        data = data[:nnz].copy()
+    return indptr, indices, data, (n_row, n_col)
+
+
+def mmwrite(filename, indptr, indices, data, shape, symmetric=False):
+    """Write a CSR matrix (indptr, indices, data) of the given shape
+
+    The field is real, integer or complex according to data.dtype.  With
+    symmetric set the matrix is assumed to be symmetric and only its
+    lower triangle is written.
+    """
+    n_row, n_col = shape
+    name = np.frombuffer(os.fsencode(filename) + b'\x00', dtype=np.uint8)
+    crappy.mm_write_csr(name, n_row, n_col, indptr, indices, data,
+                        int(bool(symmetric)))
@@ -26,6 +26,13 @@ def configuration(parent_package='', top_path=None):
 
     base_headers = [h for h in glob.glob('base/*.h')]
     template_headers = [h for h in glob.glob('templates/example.h')]
+    template_headers += [os.path.join('templates', h) for h in
+                         ['krylov.h', 'relaxation.h', 'strength.h',
+                          'triangular.h', 'ilu.h', 'submatrix.h',
+                          'matvec.h', 'convert.h', 'matmat.h',
+                          'scale.h', 'canonical.h',
+                          'mmio.h', 'csrbin.h', 'reorder.h',
+                          'numa.h']]
     template_headers += cfg_headers
     depends = base_headers + template_headers
 
@@ -37,10 +44,21 @@ def configuration(parent_package='', top_path=None):
     import generate_functions
     generate_functions.main(template_headers, '')
 
+    # kernels carry OpenMP pragmas; they run serially unless enabled
+    extra_compile_args = []
+    extra_link_args = []
+    if os.environ.get('CRAPPY_OPENMP', '0') != '0':
+        extra_compile_args += ['-fopenmp']
+        extra_link_args += ['-fopenmp']
+    else:
+        extra_compile_args += ['-Wno-unknown-pragmas']
+
     config.add_extension('crappy',
                          define_macros=[('__STDC_FORMAT_MACROS', 1)],
                          depends=depends,
                          include_dirs=['base', 'templates'],
+                         extra_compile_args=extra_compile_args,
+                         extra_link_args=extra_link_args,
                          sources=sources)
     return config
 
@@ -0,0 +1,242 @@
+#ifndef __CANONICAL_H__
+#define __CANONICAL_H__
+
+/*
+ * In-place rewrites of the rows of a CSR matrix: canonical format
+ * (csr_canonicalize) and the drop-tolerance filters (csr_eliminate_small,
+ * csr_keep_largest).  Each row is rewritten to the front of its own
+ * slot, rows in parallel, and csr_compact_rows then closes the gaps
+ * between the rows.
+ *
+ * The row helpers are in canonical_ops.h.
+ */
+
+#include <vector>
+#include <algorithm>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "util.h"
+#include "canonical_ops.h"
+
+
+/*
+ * Bring CSR matrix A to canonical format
+ *
+ *   sort the column indices of each row, sum duplicate entries
+ *   and remove the (summed) zeros
+ *
+ * Input Arguments:
+ *   I    n_row       - number of rows in A
+ *   I    n_col       - number of columns in A
+ *   I    Ap[n_row+1] - row pointer
+ *   I    Aj[nnz(A)]  - column indices
+ *   T    Ax[nnz(A)]  - nonzeros
+ *
+ * Note:
+ *   Equivalent to csr_sort_indices, csr_sum_duplicates and
+ *   csr_eliminate_zeros in turn, but each row is visited once.
+ *   Ap, Aj, and Ax will be modified *inplace*
+ *
+ *   Rows are canonicalized in parallel, each at the front of its own
+ *   slot, and then moved down by csr_compact_rows.  Small matrices
+ *   run serially, entirely in place.
+ *
+ *   Complexity: O(nnz(A) log(max row length)), Linear for rows that
+ *   are already sorted
+ *
+ */
+template <class I, class T>
+void csr_canonicalize(const I n_row,
+                      const I n_col,
+                            I Ap[],
+                            I Aj[],
+                            T Ax[])
+{
+    bool parallel = false;
+#ifdef _OPENMP
+    parallel = omp_get_max_threads() > 1 && Ap[n_row] > parallel_threshold;
+#endif
+
+    // Canonicalize each row within its own slot.
+    std::vector<I> row_nnz(n_row);
+
+    #pragma omp parallel if(parallel)
+    {
+        std::vector< std::pair<I,T> > temp;
+
+        #pragma omp for schedule(dynamic, 64)
+        for(I i = 0; i < n_row; i++){
+            row_nnz[i] = csr_canonicalize_row(Ap[i], Ap[i+1], Aj, Ax, temp);
+        }
+    }
+
+    csr_compact_rows(n_row, Ap, Aj, Ax, &row_nnz[0], parallel);
+}
+
+
+/*
+ * Eliminate small entries from CSR matrix A
+ *
+ *   A[i,j] is removed when |A[i,j]| < tol                  (relative == 0)
+ *                       or |A[i,j]| < tol * max_k |A[i,k]| (relative != 0)
+ *
+ * Input Arguments:
+ *   I    n_row       - number of rows in A
+ *   I    n_col       - number of columns in A
+ *   I    Ap[n_row+1] - row pointer
+ *   I    Aj[nnz(A)]  - column indices
+ *   T    Ax[nnz(A)]  - nonzeros
+ *   T    tol         - drop tolerance
+ *   I    relative    - scale tol by the max-norm of each row
+ *   I    keep_diag   - never remove the diagonal entries A[i,i]
+ *
+ * Note:
+ *   Explicit zeros are always removed (unless kept as diagonal), so
+ *   tol = 0 behaves as csr_eliminate_zeros.
+ *   Ap, Aj, and Ax will be modified *inplace*
+ *
+ *   Each row is filtered in parallel to the front of its own slot,
+ *   then the rows are moved down by csr_compact_rows.
+ *
+ *   Complexity: Linear.  Specifically O(nnz(A) + n_row)
+ *
+ */
+template <class I, class T>
+void csr_eliminate_small(const I n_row,
+                         const I n_col,
+                               I Ap[],
+                               I Aj[],
+                               T Ax[],
+                         const T tol,
+                         const I relative,
+                         const I keep_diag)
+{
+    bool parallel = false;
+#ifdef _OPENMP
+    parallel = omp_get_max_threads() > 1 && Ap[n_row] > parallel_threshold;
+#endif
+
+    std::vector<I> row_nnz(n_row);
+
+    #pragma omp parallel for schedule(dynamic, 64) if(parallel)
+    for(I i = 0; i < n_row; i++){
+        const I row_start = Ap[i];
+        const I row_end   = Ap[i+1];
+
+        T threshold = magnitude(tol);
+        if(relative){
+            T row_norm = 0;
+            for(I jj = row_start; jj < row_end; jj++){
+                const T m = magnitude(Ax[jj]);
+                if(row_norm < m) row_norm = m;
+            }
+            threshold *= row_norm;
+        }
+
+        I nnz = row_start;
+        for(I jj = row_start; jj < row_end; jj++){
+            const I j = Aj[jj];
+            const T x = Ax[jj];
+            if((keep_diag && j == i) || (x != 0 && !(magnitude(x) < threshold))){
+                Aj[nnz] = j;
+                Ax[nnz] = x;
+                nnz++;
+            }
+        }
+        row_nnz[i] = nnz - row_start;
+    }
+
+    csr_compact_rows(n_row, Ap, Aj, Ax, &row_nnz[0], parallel);
+}
+
+
+/*
+ * Keep only the k largest entries (in magnitude) of each row of
+ * CSR matrix A
+ *
+ * Input Arguments:
+ *   I    n_row       - number of rows in A
+ *   I    n_col       - number of columns in A
+ *   I    Ap[n_row+1] - row pointer
+ *   I    Aj[nnz(A)]  - column indices
+ *   T    Ax[nnz(A)]  - nonzeros
+ *   I    k           - number of entries to keep per row
+ *   I    keep_diag   - also keep A[i,i], on top of the k largest
+ *
+ * Note:
+ *   Explicit zeros are always removed (unless kept as diagonal).
+ *   Ties at the k-th magnitude are broken in favour of the entry
+ *   stored first.  The kept entries stay in their original order.
+ *   Ap, Aj, and Ax will be modified *inplace*
+ *
+ *   Rows are selected in parallel with std::nth_element, then moved
+ *   down by csr_compact_rows.
+ *
+ *   Complexity: Linear on average.  Specifically O(nnz(A) + n_row)
+ *
+ */
+template <class I, class T>
+void csr_keep_largest(const I n_row,
+                      const I n_col,
+                            I Ap[],
+                            I Aj[],
+                            T Ax[],
+                      const I k,
+                      const I keep_diag)
+{
+    bool parallel = false;
+#ifdef _OPENMP
+    parallel = omp_get_max_threads() > 1 && Ap[n_row] > parallel_threshold;
+#endif
+
+    std::vector<I> row_nnz(n_row);
+
+    #pragma omp parallel if(parallel)
+    {
+        // (magnitude, -position) pairs, so larger compares greater and
+        // earlier positions win ties
+        std::vector< std::pair<T,I> > temp;
+        std::vector<I> kept;
+
+        #pragma omp for schedule(dynamic, 64)
+        for(I i = 0; i < n_row; i++){
+            const I row_start = Ap[i];
+            const I row_end   = Ap[i+1];
+
+            temp.clear();
+            kept.clear();
+            for(I jj = row_start; jj < row_end; jj++){
+                if(keep_diag && Aj[jj] == i){
+                    kept.push_back(jj);
+                } else if(Ax[jj] != 0){
+                    temp.push_back(std::make_pair(magnitude(Ax[jj]), (I)(row_start - jj)));
+                }
+            }
+
+            const I n_keep = std::max((I)0, std::min(k, (I)temp.size()));
+            if(n_keep < (I)temp.size()){
+                std::nth_element(temp.begin(), temp.begin() + n_keep, temp.end(),
+                                 std::greater< std::pair<T,I> >());
+            }
+            for(I n = 0; n < n_keep; n++){
+                kept.push_back(row_start - temp[n].second);
+            }
+            std::sort(kept.begin(), kept.end());
+
+            I nnz = row_start;
+            for(typename std::vector<I>::const_iterator it = kept.begin(); it != kept.end(); ++it){
+                Aj[nnz] = Aj[*it];
+                Ax[nnz] = Ax[*it];
+                nnz++;
+            }
+            row_nnz[i] = nnz - row_start;
+        }
+    }
+
+    csr_compact_rows(n_row, Ap, Aj, Ax, &row_nnz[0], parallel);
+}
+
+#endif
@@ -0,0 +1,294 @@
+#ifndef __CANONICAL_OPS_H__
+#define __CANONICAL_OPS_H__
+
+/*
+ * Row helpers of the in-place rewrites in canonical.h, and the row
+ * sorts of coo_tocsr in convert.h.  They take std::vector work space
+ * or a bool, which generate_functions.py cannot wrap, so they are kept
+ * out of the built headers.
+ */
+
+#include <vector>
+#include <algorithm>
+
+#include "util.h"
+
+
+/*
+ * Close the gaps in CSR matrix A after each row i has moved the
+ * row_nnz[i] entries it keeps to the front of its slot
+ *
+ * Input Arguments:
+ *   I    n_row          - number of rows in A
+ *   I    Ap[n_row+1]    - row pointer
+ *   I    Aj[nnz(A)]     - column indices
+ *   T    Ax[nnz(A)]     - nonzeros
+ *   I    row_nnz[n_row] - number of entries kept in each row
+ *   bool parallel       - move the rows in parallel
+ *
+ * Note:
+ *   Ap, Aj, and Ax will be modified *inplace*
+ *
+ *   The new Ap is a prefix sum of row_nnz.  In parallel the move goes
+ *   through a buffer of nnz entries, since a row's new slot may
+ *   overlap an earlier row that has not been moved yet.  Serially the
+ *   rows are moved down in place.
+ *
+ */
+template <class I, class T>
+void csr_compact_rows(const I n_row,
+                            I Ap[],
+                            I Aj[],
+                            T Ax[],
+                      const I row_nnz[],
+                      const bool parallel)
+{
+    if(!parallel){
+        I nnz = 0;
+        I row_end = 0;
+        for(I i = 0; i < n_row; i++){
+            const I row_start = row_end;
+            row_end = Ap[i+1];
+            for(I jj = row_start; jj < row_start + row_nnz[i]; jj++){
+                Aj[nnz] = Aj[jj];
+                Ax[nnz] = Ax[jj];
+                nnz++;
+            }
+            Ap[i+1] = nnz;
+        }
+        return;
+    }
+
+    std::vector<I> Bp(n_row + 1);
+    Bp[0] = 0;
+    for(I i = 0; i < n_row; i++){
+        Bp[i+1] = Bp[i] + row_nnz[i];
+    }
+
+    const I new_nnz = Bp[n_row];
+    std::vector<I> Bj(new_nnz);
+    std::vector<T> Bx(new_nnz);
+
+    #pragma omp parallel
+    {
+        #pragma omp for schedule(static)
+        for(I i = 0; i < n_row; i++){
+            std::copy(Aj + Ap[i], Aj + Ap[i] + row_nnz[i], Bj.begin() + Bp[i]);
+            std::copy(Ax + Ap[i], Ax + Ap[i] + row_nnz[i], Bx.begin() + Bp[i]);
+        }
+
+        #pragma omp for schedule(static)
+        for(I n = 0; n < new_nnz; n++){
+            Aj[n] = Bj[n];
+            Ax[n] = Bx[n];
+        }
+
+        #pragma omp for schedule(static)
+        for(I i = 0; i < n_row; i++){
+            Ap[i+1] = Bp[i+1];
+        }
+    }
+}
+
+
+/*
+ * Sort, sum duplicates and drop zeros in row [row_start, row_end)
+ *
+ * The surviving entries are written at the front of the row, in
+ * place, and their number is returned.  Rows that are already sorted
+ * are merged without copying to temp.
+ *
+ */
+template <class I, class T>
+I csr_canonicalize_row(const I row_start,
+                       const I row_end,
+                             I Aj[],
+                             T Ax[],
+                       std::vector< std::pair<I,T> >& temp)
+{
+    bool sorted = true;
+    for(I jj = row_start + 1; jj < row_end && sorted; jj++){
+        sorted = !(Aj[jj] < Aj[jj-1]);
+    }
+
+    I nnz = row_start;
+
+    if(sorted){
+        I jj = row_start;
+        while( jj < row_end ){
+            const I j = Aj[jj];
+            T x = Ax[jj];
+            jj++;
+            while( jj < row_end && Aj[jj] == j ){
+                x += Ax[jj];
+                jj++;
+            }
+            if(x != 0){
+                Aj[nnz] = j;
+                Ax[nnz] = x;
+                nnz++;
+            }
+        }
+        return nnz - row_start;
+    }
+
+    temp.clear();
+    for(I jj = row_start; jj < row_end; jj++){
+        temp.push_back(std::make_pair(Aj[jj],Ax[jj]));
+    }
+    std::sort(temp.begin(),temp.end(),kv_pair_less<I,T>);
+
+    typename std::vector< std::pair<I,T> >::const_iterator it = temp.begin();
+    while( it != temp.end() ){
+        const I j = it->first;
+        T x = it->second;
+        ++it;
+        while( it != temp.end() && it->first == j ){
+            x += it->second;
+            ++it;
+        }
+        if(x != 0){
+            Aj[nnz] = j;
+            Ax[nnz] = x;
+            nnz++;
+        }
+    }
+    return nnz - row_start;
+}
+
+
+/*
+ * Stable sort of the len entries (Aj, Ax) of one row by column index
+ *
+ * Short rows use insertion sort, in place.  Longer rows use an LSD
+ * radix sort on 8-bit digits of the column index, with tj and tx as
+ * the second buffer; only the digits needed for n_col are sorted, and
+ * passes where every key shares the digit are skipped.
+ *
+ */
+template <class I, class T>
+void csr_sort_row(const I len,
+                  const I n_col,
+                        I Aj[],
+                        T Ax[],
+                  std::vector<I>& tj,
+                  std::vector<T>& tx)
+{
+    if(len <= 64){ // constant is arbitrary
+        for(I n = 1; n < len; n++){
+            const I j = Aj[n];
+            const T x = Ax[n];
+            I m = n;
+            for(; m > 0 && j < Aj[m-1]; m--){
+                Aj[m] = Aj[m-1];
+                Ax[m] = Ax[m-1];
+            }
+            Aj[m] = j;
+            Ax[m] = x;
+        }
+        return;
+    }
+
+    tj.resize(len);
+    tx.resize(len);
+
+    I * src_j = Aj, * dst_j = &tj[0];
+    T * src_x = Ax, * dst_x = &tx[0];
+    I count[257];
+
+    for(int shift = 0; shift < (int)(8 * sizeof(I)) && ((n_col - 1) >> shift) > 0; shift += 8){
+        std::fill(count, count + 257, 0);
+        for(I n = 0; n < len; n++){
+            count[((src_j[n] >> shift) & 0xff) + 1]++;
+        }
+        if(count[((src_j[0] >> shift) & 0xff) + 1] == len){
+            continue;
+        }
+        for(int d = 0; d < 256; d++){
+            count[d+1] += count[d];
+        }
+        for(I n = 0; n < len; n++){
+            const I dest = count[(src_j[n] >> shift) & 0xff]++;
+            dst_j[dest] = src_j[n];
+            dst_x[dest] = src_x[n];
+        }
+        std::swap(src_j, dst_j);
+        std::swap(src_x, dst_x);
+    }
+
+    if(src_j != Aj){
+        std::copy(src_j, src_j + len, Aj);
+        std::copy(src_x, src_x + len, Ax);
+    }
+}
+
+
+/*
+ * Sort the column indices of each row of CSR matrix B and optionally
+ * sum duplicate entries
+ *
+ * Input Arguments:
+ *   I    n_row          - number of rows in B
+ *   I    n_col          - number of columns in B
+ *   I    Bp[n_row+1]    - row pointer
+ *   I    Bj[nnz(B)]     - column indices
+ *   T    Bx[nnz(B)]     - nonzeros
+ *   I    sum_duplicates - merge entries with equal column index
+ *   bool parallel       - run in parallel
+ *
+ * Note:
+ *   Bp, Bj, and Bx will be modified *inplace*
+ *
+ *   Rows are sorted by csr_sort_row, which is stable, so duplicates
+ *   are summed in storage order.  Explicit zeros are retained.
+ *
+ */
+template <class I, class T>
+void csr_sort_rows(const I n_row,
+                   const I n_col,
+                         I Bp[],
+                         I Bj[],
+                         T Bx[],
+                   const I sum_duplicates,
+                   const bool parallel)
+{
+    std::vector<I> row_nnz(sum_duplicates ? n_row : 0);
+
+    #pragma omp parallel if(parallel)
+    {
+        std::vector<I> tj;
+        std::vector<T> tx;
+
+        #pragma omp for schedule(dynamic, 64)
+        for(I i = 0; i < n_row; i++){
+            const I row_start = Bp[i];
+            const I row_end   = Bp[i+1];
+
+            csr_sort_row((I)(row_end - row_start), n_col, Bj + row_start, Bx + row_start, tj, tx);
+
+            if(sum_duplicates){
+                I kk = row_start;
+                I jj = row_start;
+                while( jj < row_end ){
+                    const I j = Bj[jj];
+                    T x = Bx[jj];
+                    jj++;
+                    while( jj < row_end && Bj[jj] == j ){
+                        x += Bx[jj];
+                        jj++;
+                    }
+                    Bj[kk] = j;
+                    Bx[kk] = x;
+                    kk++;
+                }
+                row_nnz[i] = kk - row_start;
+            }
+        }
+    }
+
+    if(sum_duplicates){
+        csr_compact_rows(n_row, Bp, Bj, Bx, &row_nnz[0], parallel);
+    }
+}
+
+#endif
@@ -0,0 +1,224 @@
+#ifndef __CONVERT_H__
+#define __CONVERT_H__
+
+/*
+ * Conversions between CSR and other sparse formats.
+ */
+
+#include <vector>
+#include <algorithm>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "util.h"
+#include "canonical_ops.h"
+
+
+/*
+ * Compute B = A for CSR matrix A, CSC matrix B
+ *
+ * Also, with the appropriate arguments can also be used to:
+ *   - compute B = A^t for CSR matrix A, CSR matrix B
+ *   - compute B = A^t for CSC matrix A, CSC matrix B
+ *   - convert CSC->CSR
+ *
+ * Input Arguments:
+ *   I  n_row         - number of rows in A
+ *   I  n_col         - number of columns in A
+ *   P  Ap[n_row+1]   - row pointer
+ *   I  Aj[nnz(A)]    - column indices
+ *   T  Ax[nnz(A)]    - nonzeros
+ *
+ * Output Arguments:
+ *   P  Bp[n_col+1] - column pointer
+ *   I  Bj[nnz(A)]  - row indices
+ *   T  Bx[nnz(A)]  - nonzeros
+ *
+ * Note:
+ *   Output arrays Bp, Bj, Bx must be preallocated
+ *
+ * Note: 
+ *   Input:  column indices *are not* assumed to be in sorted order
+ *   Output: row indices *will be* in sorted order
+ *
+ *   The pointer type P of Ap and Bp may be wider than the index type I
+ *   of Aj and Bi (e.g. nnz(A) >= 2^31 with 32-bit indices).
+ *
+ *   Complexity: Linear.  Specifically O(nnz(A) + max(n_row,n_col))
+ * 
+ */
+template <class I, class T, class P>
+void csr_tocsc(const I n_row,
+	           const I n_col, 
+	           const P Ap[], 
+	           const I Aj[], 
+	           const T Ax[],
+	                 P Bp[],
+	                 I Bi[],
+	                 T Bx[])
+{  
+    const P nnz = Ap[n_row];
+
+    //compute number of non-zero entries per column of A 
+    std::fill(Bp, Bp + n_col, 0);
+
+    for (P n = 0; n < nnz; n++){            
+        Bp[Aj[n]]++;
+    }
+
+    //cumsum the nnz per column to get Bp[]
+    P cumsum = 0;
+    for(I col = 0; col < n_col; col++){     
+        P temp  = Bp[col];
+        Bp[col] = cumsum;
+        cumsum += temp;
+    }
+    Bp[n_col] = nnz; 
+
+    for(I row = 0; row < n_row; row++){
+        for(P jj = Ap[row]; jj < Ap[row+1]; jj++){
+            I col  = Aj[jj];
+            P dest = Bp[col];
+
+            Bi[dest] = row;
+            Bx[dest] = Ax[jj];
+
+            Bp[col]++;
+        }
+    }  
+
+    P last = 0;
+    for(I col = 0; col <= n_col; col++){
+        P temp  = Bp[col];
+        Bp[col] = last;
+        last    = temp;
+    }
+}   
+
+
+/*
+ * Compute B = A for COO matrix A, CSR matrix B
+ *
+ *
+ * Input Arguments:
+ *   I  n_row           - number of rows in A
+ *   I  n_col           - number of columns in A
+ *   I  nnz             - number of nonzeros in A
+ *   I  Ai[nnz(A)]      - row indices
+ *   I  Aj[nnz(A)]      - column indices
+ *   T  Ax[nnz(A)]      - nonzeros
+ *   I  sum_duplicates  - merge entries with equal (row, column)
+ *
+ * Output Arguments:
+ *   I  Bp[n_row+1]     - row pointer
+ *   I  Bj[nnz(A)]      - column indices
+ *   T  Bx[nnz(A)]      - nonzeros
+ *
+ * Returns:
+ *   nnz(B), which is less than nnz(A) only when duplicates were summed
+ *
+ * Note:
+ *   Output arrays Bp, Bj, and Bx must be preallocated
+ *
+ * Note:
+ *   Input:  row and column indices *are not* assumed to be ordered
+ *
+ *   Output: column indices *will be* in sorted order; entries with
+ *           equal (row, column) keep their input order, or are summed
+ *           in input order when sum_duplicates is set, so B is then in
+ *           canonical format.  Explicit zeros are retained.
+ *
+ *   The triples are split into one contiguous chunk per thread.  The
+ *   rows of each chunk are counted, the counts are prefix-summed
+ *   row-major over (row, chunk), and each chunk is scattered to the
+ *   offsets so obtained; this is the same placement as the serial
+ *   scatter, whatever the size of the team.  The chunk count is
+ *   limited so that the per-chunk counts hold at most nnz(A) entries.
+ *   Rows are then sorted, and duplicates summed, in parallel by
+ *   csr_sort_rows.
+ *
+ *   Complexity: Linear.  Specifically O(nnz(A) + n_row) plus, for each
+ *   row longer than 64, one pass per byte of n_col
+ *
+ */
+template <class I, class T>
+I coo_tocsr(const I n_row,
+            const I n_col,
+            const I nnz,
+            const I Ai[],
+            const I Aj[],
+            const T Ax[],
+                  I Bp[],
+                  I Bj[],
+                  T Bx[],
+            const I sum_duplicates)
+{
+    Bp[0] = 0;
+    if(n_row == 0){
+        return 0;
+    }
+
+    bool parallel = false;
+    int n_threads = 1;
+#ifdef _OPENMP
+    parallel = omp_get_max_threads() > 1 && nnz > parallel_threshold;
+    if(parallel){
+        n_threads = (int)std::min<npy_intp>(omp_get_max_threads(), std::max<npy_intp>(1, nnz / n_row));
+    }
+#endif
+
+    // one chunk of triples per thread asked for; the team may be
+    // smaller, so chunks are handed out by omp for
+    const int n_chunks = n_threads;
+    std::vector<I> counts((npy_intp)n_chunks * n_row, 0);
+
+    #pragma omp parallel num_threads(n_threads) if(n_threads > 1)
+    {
+        #pragma omp for schedule(static, 1)
+        for(int c = 0; c < n_chunks; c++){
+            const I n_start = (I)((npy_intp)nnz * c / n_chunks);
+            const I n_end   = (I)((npy_intp)nnz * (c + 1) / n_chunks);
+            I * offset = &counts[0] + (npy_intp)n_row * c;
+
+            for(I n = n_start; n < n_end; n++){
+                offset[Ai[n]]++;
+            }
+        }
+
+        #pragma omp single
+        {
+            I sum = 0;
+            for(I i = 0; i < n_row; i++){
+                Bp[i] = sum;
+                for(int c = 0; c < n_chunks; c++){
+                    I& count = counts[(npy_intp)n_row * c + i];
+                    const I temp = count;
+                    count = sum;
+                    sum += temp;
+                }
+            }
+            Bp[n_row] = sum;
+        }
+
+        #pragma omp for schedule(static, 1)
+        for(int c = 0; c < n_chunks; c++){
+            const I n_start = (I)((npy_intp)nnz * c / n_chunks);
+            const I n_end   = (I)((npy_intp)nnz * (c + 1) / n_chunks);
+            I * offset = &counts[0] + (npy_intp)n_row * c;
+
+            for(I n = n_start; n < n_end; n++){
+                const I dest = offset[Ai[n]]++;
+                Bj[dest] = Aj[n];
+                Bx[dest] = Ax[n];
+            }
+        }
+    }
+
+    csr_sort_rows(n_row, n_col, Bp, Bj, Bx, sum_duplicates, parallel);
+
+    return Bp[n_row];
+}
+
+#endif
@@ -0,0 +1,361 @@
+#ifndef __CSR_BINOP_H__
+#define __CSR_BINOP_H__
+
+/*
+ * The engine of the element-wise binary operations of
+ * example_scipy_csr.h (csr_plus_csr, csr_lt_csr, ...): C = A op B for
+ * CSR matrices A and B and a functor op.
+ *
+ * It is kept apart from example_scipy_csr.h because a functor
+ * parameter cannot be expressed by generate_functions.py, which parses
+ * every template of the headers it wraps.
+ *
+ * No routine writes past the last nonzero of C it keeps, so C may be
+ * allocated with exactly nnz(C) entries when that is known.
+ */
+
+#include <vector>
+#include <algorithm>
+
+template <class I>
+bool csr_has_canonical_format(const I n_row,
+                              const I Ap[],
+                              const I Aj[]);
+
+
+/*
+ * Compute C = A (binary_op) B for CSR matrices that are not
+ * necessarily canonical CSR format.  Specifically, this method
+ * works even when the input matrices have duplicate and/or
+ * unsorted column indices within a given row.
+ *
+ * Refer to csr_binop_csr() for additional information
+ *
+ * Note:
+ *   Output arrays Cp, Cj, and Cx must be preallocated
+ *   If nnz(C) is not known a priori, a conservative bound is:
+ *          nnz(C) <= nnz(A) + nnz(B)
+ *
+ * Note:
+ *   Input:  A and B column indices are not assumed to be in sorted order
+ *   Output: C column indices are not generally in sorted order
+ *           C will not contain any duplicate entries or explicit zeros.
+ *
+ */
+template <class I, class T, class T2, class binary_op>
+void csr_binop_csr_general(const I n_row, const I n_col,
+                           const I Ap[], const I Aj[], const T Ax[],
+                           const I Bp[], const I Bj[], const T Bx[],
+                                 I Cp[],       I Cj[],      T2 Cx[],
+                           const binary_op& op)
+{
+    //Method that works for duplicate and/or unsorted indices
+
+    std::vector<I>  next(n_col,-1);
+    std::vector<T> A_row(n_col, 0);
+    std::vector<T> B_row(n_col, 0);
+
+    I nnz = 0;
+    Cp[0] = 0;
+
+    for(I i = 0; i < n_row; i++){
+        I head   = -2;
+        I length =  0;
+
+        //add a row of A to A_row
+        for(I jj = Ap[i]; jj < Ap[i+1]; jj++){
+            I j = Aj[jj];
+
+            A_row[j] += Ax[jj];
+
+            if(next[j] == -1){
+                next[j] = head;
+                head = j;
+                length++;
+            }
+        }
+
+        //add a row of B to B_row
+        for(I jj = Bp[i]; jj < Bp[i+1]; jj++){
+            I j = Bj[jj];
+
+            B_row[j] += Bx[jj];
+
+            if(next[j] == -1){
+                next[j] = head;
+                head = j;
+                length++;
+            }
+        }
+
+
+        // scan through columns where A or B has
+        // contributed a non-zero entry
+        for(I jj = 0; jj < length; jj++){
+            T2 result = op(A_row[head], B_row[head]);
+
+            if(result != 0){
+                Cj[nnz] = head;
+                Cx[nnz] = result;
+                nnz++;
+            }
+
+            I temp = head;
+            head = next[head];
+
+            next[temp]  = -1;
+            A_row[temp] =  0;
+            B_row[temp] =  0;
+        }
+
+        Cp[i + 1] = nnz;
+    }
+}
+
+
+/*
+ * Number of entries the canonical path evaluates op on at a time
+ */
+const int csr_binop_chunk = 64; // constant is arbitrary
+
+/*
+ * Apply op to len aligned pairs (a[n], b[n]) at columns cols[n] and
+ * append the nonzero results to C
+ *
+ * op is mapped over the arrays first, in a loop without branches that
+ * the compiler vectorizes for the arithmetic functors.  The nonzeros
+ * are then packed without branches into the local buffers, where a
+ * store past the last one is harmless, and copied to C.
+ */
+template <class I, class T, class T2, class binary_op>
+I csr_binop_chunk_apply(const I len, const I cols[], const T a[], const T b[],
+                        I nnz, I Cj[], T2 Cx[],
+                        const binary_op& op)
+{
+    T2 result[csr_binop_chunk];
+    I  packed_j[csr_binop_chunk];
+    T2 packed_x[csr_binop_chunk];
+
+    for(I n = 0; n < len; n++){
+        result[n] = op(a[n], b[n]);
+    }
+    I count = 0;
+    for(I n = 0; n < len; n++){
+        packed_j[count] = cols[n];
+        packed_x[count] = result[n];
+        count += (result[n] != 0);
+    }
+    std::copy(packed_j, packed_j + count, Cj + nnz);
+    std::copy(packed_x, packed_x + count, Cx + nnz);
+    return nnz + count;
+}
+
+/*
+ * Apply op to a run of entries present in only one of A or B and
+ * append the nonzero results to C, without comparing column indices
+ */
+template <class I, class T, class T2, class binary_op>
+I csr_binop_tail(const I len, const I Xj[], const T Xx[],
+                 const bool x_is_a, I nnz, I Cj[], T2 Cx[],
+                 const binary_op& op)
+{
+    T zeros[csr_binop_chunk];
+    std::fill(zeros, zeros + csr_binop_chunk, T(0));
+
+    for(I n = 0; n < len; n += csr_binop_chunk){
+        const I m = std::min(len - n, (I)csr_binop_chunk);
+        if(x_is_a){
+            nnz = csr_binop_chunk_apply(m, Xj + n, Xx + n, zeros, nnz, Cj, Cx, op);
+        } else {
+            nnz = csr_binop_chunk_apply(m, Xj + n, zeros, Xx + n, nnz, Cj, Cx, op);
+        }
+    }
+    return nnz;
+}
+
+
+/*
+ * Compute C = A (binary_op) B for CSR matrices that are in the
+ * canonical CSR format.  Specifically, this method requires that
+ * the rows of the input matrices are free of duplicate column indices
+ * and that the column indices are in sorted order.
+ *
+ * Refer to csr_binop_csr() for additional information
+ *
+ * Note:
+ *   Input:  A and B column indices are assumed to be in sorted order
+ *   Output: C column indices will be in sorted order
+ *           Cx will not contain any zero entries
+ *
+ *   Each row is a linear merge of the two sorted rows:
+ *     - where A and B share the row's sparsity pattern (e.g. A + A.T
+ *       for a structurally symmetric A, or updates of a fixed
+ *       pattern) op is mapped over the two value arrays directly
+ *     - long rows are merged csr_binop_chunk entries at a time: the
+ *       merge step picks the columns and operands without branches,
+ *       and op is then applied to the whole chunk in a vector loop
+ *     - once one row is exhausted, the rest of the other row is
+ *       handled by csr_binop_tail without comparing column indices
+ *   Short rows take the plain scalar merge.
+ *
+ */
+template <class I, class T, class T2, class binary_op>
+void csr_binop_csr_canonical(const I n_row, const I n_col,
+                             const I Ap[], const I Aj[], const T Ax[],
+                             const I Bp[], const I Bj[], const T Bx[],
+                                   I Cp[],       I Cj[],      T2 Cx[],
+                             const binary_op& op)
+{
+    //Method that works for canonical CSR matrices
+
+    const T zero = 0;
+    I  cols[csr_binop_chunk];
+    T  A_val[csr_binop_chunk];
+    T  B_val[csr_binop_chunk];
+
+    Cp[0] = 0;
+    I nnz = 0;
+
+    for(I i = 0; i < n_row; i++){
+        I A_pos = Ap[i];
+        I B_pos = Bp[i];
+        I A_end = Ap[i+1];
+        I B_end = Bp[i+1];
+
+        //shared pattern: no merge needed
+        if(A_end - A_pos == B_end - B_pos &&
+           std::equal(Aj + A_pos, Aj + A_end, Bj + B_pos)){
+            for(; A_pos < A_end; A_pos += csr_binop_chunk){
+                const I m = std::min(A_end - A_pos, (I)csr_binop_chunk);
+                nnz = csr_binop_chunk_apply(m, Aj + A_pos, Ax + A_pos, Bx + B_pos,
+                                            nnz, Cj, Cx, op);
+                B_pos += m;
+            }
+            Cp[i + 1] = nnz;
+            continue;
+        }
+
+        //long rows: branch-free merge of a chunk, then op on the chunk
+        if((A_end - A_pos) + (B_end - B_pos) >= csr_binop_chunk){
+            T A_or_zero[2] = {zero, zero};
+            T B_or_zero[2] = {zero, zero};
+            while(A_pos < A_end && B_pos < B_end){
+                // each step consumes an entry of A, of B, or of both
+                const I len = std::min(std::min(A_end - A_pos, B_end - B_pos),
+                                       (I)csr_binop_chunk);
+                for(I m = 0; m < len; m++){
+                    const I A_j = Aj[A_pos];
+                    const I B_j = Bj[B_pos];
+                    const bool take_a = !(B_j < A_j);
+                    const bool take_b = !(A_j < B_j);
+                    A_or_zero[1] = Ax[A_pos];
+                    B_or_zero[1] = Bx[B_pos];
+                    cols[m]  = take_a ? A_j : B_j;
+                    A_val[m] = A_or_zero[take_a];
+                    B_val[m] = B_or_zero[take_b];
+                    A_pos += take_a;
+                    B_pos += take_b;
+                }
+                nnz = csr_binop_chunk_apply(len, cols, A_val, B_val, nnz, Cj, Cx, op);
+            }
+        }
+
+        //while not finished with either row
+        while(A_pos < A_end && B_pos < B_end){
+            I A_j = Aj[A_pos];
+            I B_j = Bj[B_pos];
+
+            if(A_j == B_j){
+                T2 result = op(Ax[A_pos],Bx[B_pos]);
+                if(result != 0){
+                    Cj[nnz] = A_j;
+                    Cx[nnz] = result;
+                    nnz++;
+                }
+                A_pos++;
+                B_pos++;
+            } else if (A_j < B_j) {
+                T2 result = op(Ax[A_pos],0);
+                if (result != 0){
+                    Cj[nnz] = A_j;
+                    Cx[nnz] = result;
+                    nnz++;
+                }
+                A_pos++;
+            } else {
+                //B_j < A_j
+                T2 result = op(0,Bx[B_pos]);
+                if (result != 0){
+                    Cj[nnz] = B_j;
+                    Cx[nnz] = result;
+                    nnz++;
+                }
+                B_pos++;
+            }
+        }
+
+        //tail
+        nnz = csr_binop_tail(A_end - A_pos, Aj + A_pos, Ax + A_pos,
+                             true, nnz, Cj, Cx, op);
+        nnz = csr_binop_tail(B_end - B_pos, Bj + B_pos, Bx + B_pos,
+                             false, nnz, Cj, Cx, op);
+
+        Cp[i+1] = nnz;
+    }
+}
+
+
+/*
+ * Compute C = A (binary_op) B for CSR matrices A,B where the column
+ * indices with the rows of A and B are known to be sorted.
+ *
+ *   binary_op(x,y) - binary operator to apply elementwise
+ *
+ * Input Arguments:
+ *   I    n_row       - number of rows in A (and B)
+ *   I    n_col       - number of columns in A (and B)
+ *   I    Ap[n_row+1] - row pointer
+ *   I    Aj[nnz(A)]  - column indices
+ *   T    Ax[nnz(A)]  - nonzeros
+ *   I    Bp[n_row+1] - row pointer
+ *   I    Bj[nnz(B)]  - column indices
+ *   T    Bx[nnz(B)]  - nonzeros
+ * Output Arguments:
+ *   I    Cp[n_row+1] - row pointer
+ *   I    Cj[nnz(C)]  - column indices
+ *   T    Cx[nnz(C)]  - nonzeros
+ *
+ * Note:
+ *   Output arrays Cp, Cj, and Cx must be preallocated
+ *   If nnz(C) is not known a priori, a conservative bound is:
+ *          nnz(C) <= nnz(A) + nnz(B)
+ *   Nothing is written past the nnz(C) entries kept, so arrays of
+ *   exactly nnz(C) entries (e.g. nnz(A) for A op A) are enough.
+ *
+ * Note:
+ *   Input:  A and B column indices are not assumed to be in sorted order.
+ *   Output: C column indices will be in sorted if both A and B have sorted indices.
+ *           Cx will not contain any zero entries
+ *
+ */
+template <class I, class T, class T2, class binary_op>
+void csr_binop_csr(const I n_row,
+                   const I n_col,
+                   const I Ap[],
+                   const I Aj[],
+                   const T Ax[],
+                   const I Bp[],
+                   const I Bj[],
+                   const T Bx[],
+                         I Cp[],
+                         I Cj[],
+                        T2 Cx[],
+                   const binary_op& op)
+{
+    if (csr_has_canonical_format(n_row,Ap,Aj) && csr_has_canonical_format(n_row,Bp,Bj))
+        csr_binop_csr_canonical(n_row, n_col, Ap, Aj, Ax, Bp, Bj, Bx, Cp, Cj, Cx, op);
+    else
+        csr_binop_csr_general(n_row, n_col, Ap, Aj, Ax, Bp, Bj, Bx, Cp, Cj, Cx, op);
+}
+
+#endif
@@ -0,0 +1,137 @@
+#ifndef __CSR_SYMV_H__
+#define __CSR_SYMV_H__
+
+/*
+ * Row kernels of csr_symv in matvec.h.
+ *
+ * They take hermitian as a template parameter, which
+ * generate_functions.py cannot express, so they are kept out of the
+ * headers it parses.
+ */
+
+#include <vector>
+#include <algorithm>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "util.h"
+
+
+/*
+ * Apply rows [r0,r1) of a one-triangle symmetric (or Hermitian)
+ * matrix.  The mirrored contribution of an entry lands in Yx when
+ * its column is inside [r0,r1) and in remote[j - remote_lo] otherwise.
+ */
+template <bool hermitian, class I, class T>
+void csr_symv_rows(const I r0,
+                   const I r1,
+                   const I Ap[],
+                   const I Aj[],
+                   const T Ax[],
+                   const T Xx[],
+                         T Yx[],
+                         T remote[],
+                   const I remote_lo)
+{
+    for(I i = r0; i < r1; i++){
+        const T xi = Xx[i];
+        T sum = 0;
+        for(I jj = Ap[i]; jj < Ap[i+1]; jj++){
+            const I j = Aj[jj];
+            const T a = Ax[jj];
+
+            if(j == i){
+                sum += a * xi;
+                continue;
+            }
+
+            sum += a * Xx[j];
+
+            const T at = hermitian ? conjugate(a) : a;
+            if(j >= r0 && j < r1)
+                Yx[j] += at * xi;
+            else
+                remote[j - remote_lo] += at * xi;
+        }
+        Yx[i] += sum;
+    }
+}
+
+
+#ifdef _OPENMP
+/*
+ * Parallel csr_symv over row blocks of equal nnz
+ *
+ * A thread owns the entries of Y for its row block and is the only
+ * writer to them.  Mirrored contributions to rows owned by other
+ * blocks go to a private buffer spanning just the range of those
+ * columns (about the bandwidth for banded matrices); the buffers
+ * are added into Y afterwards, row-parallel.  No atomics are needed.
+ *
+ */
+template <bool hermitian, class I, class T>
+void csr_symv_blocked(const I n_row,
+                      const I Ap[],
+                      const I Aj[],
+                      const T Ax[],
+                      const T Xx[],
+                            T Yx[],
+                      const int n_blocks)
+{
+    const npy_intp nnz = Ap[n_row];
+
+    // Row blocks of equal nnz.
+    std::vector<I> block_ptr(n_blocks + 1);
+    block_ptr[0] = 0;
+    for(int b = 1; b < n_blocks; b++){
+        const I target = (I)(nnz * b / n_blocks);
+        block_ptr[b] = std::max(block_ptr[b-1],
+                                (I)(std::lower_bound(Ap, Ap + n_row + 1, target) - Ap));
+    }
+    block_ptr[n_blocks] = n_row;
+
+    // Column range of the remote contributions of each block.
+    std::vector<I> remote_lo(n_blocks, n_row);
+    std::vector<I> remote_hi(n_blocks, 0);
+
+    #pragma omp parallel for schedule(static, 1) num_threads(n_blocks)
+    for(int b = 0; b < n_blocks; b++){
+        const I r0 = block_ptr[b];
+        const I r1 = block_ptr[b+1];
+        I lo = n_row, hi = 0;
+        for(I jj = Ap[r0]; jj < Ap[r1]; jj++){
+            const I j = Aj[jj];
+            if(j < r0 || j >= r1){
+                lo = std::min(lo, j);
+                hi = std::max(hi, (I)(j + 1));
+            }
+        }
+        remote_lo[b] = lo;
+        remote_hi[b] = std::max(lo, hi);
+    }
+
+    std::vector< std::vector<T> > remote(n_blocks);
+
+    #pragma omp parallel for schedule(static, 1) num_threads(n_blocks)
+    for(int b = 0; b < n_blocks; b++){
+        remote[b].assign(remote_hi[b] - remote_lo[b] + 1, T(0));
+        csr_symv_rows<hermitian>(block_ptr[b], block_ptr[b+1], Ap, Aj, Ax, Xx, Yx,
+                                 &remote[b][0], remote_lo[b]);
+    }
+
+    #pragma omp parallel for schedule(static)
+    for(I i = 0; i < n_row; i++){
+        T sum = Yx[i];
+        for(int b = 0; b < n_blocks; b++){
+            if(i >= remote_lo[b] && i < remote_hi[b]){
+                sum += remote[b][i - remote_lo[b]];
+            }
+        }
+        Yx[i] = sum;
+    }
+}
+#endif
+
+#endif
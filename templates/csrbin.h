@@ -0,0 +1,74 @@
+#ifndef __CSRBIN_H__
+#define __CSRBIN_H__
+
+/*
+ * Out-of-core SpMV over the binary CSR container, callable from
+ * Python.  The container format, csr_write_binary, csr_binary_file and
+ * the streaming csr_matvec_binary itself are in csrbin_ops.h.
+ */
+
+#include <string>
+#include <stdexcept>
+
+#include "csrbin_ops.h"
+
+
+/*
+ * Compute Y += A*X for CSR matrix A stored in a binary container,
+ * streaming A from disk (see csr_matvec_binary)
+ *
+ * Input Arguments:
+ *   char filename[]  - path of the binary CSR file, NUL-terminated
+ *   T  Xx[n_col]     - input vector
+ *   I  block_bytes   - target size of a block of Aj and Ax in memory
+ *
+ * Output Arguments:
+ *   T  Yx[n_row]     - output vector
+ *   I  stats[6]      - wall, read, compute and stall times of
+ *                      csrbin_stream_stats in nanoseconds, then the
+ *                      bytes of Aj and Ax read and the number of blocks
+ *
+ * Note:
+ *   Output array Yx must be preallocated
+ *
+ *   The index types of Ap and Aj are the ones stored in the file, so
+ *   I only types block_bytes and stats; pass a 64-bit stats array.
+ *   T must be the stored type of Ax.
+ *
+ */
+template <class I, class T>
+void csr_matvec_binary_stream(const char filename[],
+                              const T Xx[],
+                                    T Yx[],
+                              const I block_bytes,
+                                    I stats[])
+{
+    const csrbin_header h = csrbin_read_header(filename);
+    const std::string Ap_dtype(h.Ap_dtype, strnlen(h.Ap_dtype, sizeof(h.Ap_dtype)));
+    const std::string Aj_dtype(h.Aj_dtype, strnlen(h.Aj_dtype, sizeof(h.Aj_dtype)));
+    const std::string i4 = csrbin_dtype<npy_int32>::str();
+    const std::string i8 = csrbin_dtype<npy_int64>::str();
+
+    csrbin_stream_stats s;
+    if(Aj_dtype == i4 && Ap_dtype == i4){
+        csr_matvec_binary<npy_int32,T,npy_int32>(filename, Xx, Yx, block_bytes, &s);
+    } else if(Aj_dtype == i4 && Ap_dtype == i8){
+        csr_matvec_binary<npy_int32,T,npy_int64>(filename, Xx, Yx, block_bytes, &s);
+    } else if(Aj_dtype == i8 && Ap_dtype == i8){
+        csr_matvec_binary<npy_int64,T,npy_int64>(filename, Xx, Yx, block_bytes, &s);
+    } else if(Aj_dtype == i8 && Ap_dtype == i4){
+        csr_matvec_binary<npy_int64,T,npy_int32>(filename, Xx, Yx, block_bytes, &s);
+    } else {
+        throw std::invalid_argument("unsupported binary CSR index types (" +
+                                    Ap_dtype + ", " + Aj_dtype + ")");
+    }
+
+    stats[0] = (I)(s.wall    * 1e9);
+    stats[1] = (I)(s.read    * 1e9);
+    stats[2] = (I)(s.compute * 1e9);
+    stats[3] = (I)(s.stall   * 1e9);
+    stats[4] = (I)s.bytes;
+    stats[5] = (I)s.n_blocks;
+}
+
+#endif
@@ -0,0 +1,561 @@
+#ifndef __CSRBIN_OPS_H__
+#define __CSRBIN_OPS_H__
+
+/*
+ * Binary CSR container, memory-mapped for zero-copy loading.
+ *
+ * Layout (all header integers little-endian):
+ *
+ *   offset  size  field
+ *        0     8  magic "CRPYCSR\0"
+ *        8     4  version (1)
+ *       12     4  header size (152)
+ *       16     8  dtype of Ap, as a numpy type string ("<i4", "<i8", ...)
+ *       24     8  dtype of Aj
+ *       32     8  dtype of Ax ("<f8", "<c16", "|b1", ...)
+ *       40     8  n_row
+ *       48     8  n_col
+ *       56     8  nnz
+ *       64     4  flags (bit 0: canonical format)
+ *       68     4  reserved (0)
+ *       72    48  (offset, size in bytes) of the Ap, Aj and Ax sections
+ *      120    24  checksum of the Ap, Aj and Ax sections
+ *      144     8  checksum of bytes [0,144) of the header
+ *
+ * Each section starts on a 4096-byte boundary and is zero-padded to the
+ * next multiple of 8 bytes.  The checksum of a section of n_words
+ * 64-bit little-endian words w_k is
+ *
+ *   sum_k (2k+1) * w_k   mod 2^64
+ *
+ * which catches truncation, corruption and reordered words, and can be
+ * computed in parallel (or with numpy) in any order.
+ *
+ * csrbin.py reads and writes the same format from Python, and runs
+ * csr_matvec_binary through csr_matvec_binary_stream in csrbin.h.
+ */
+
+#include <cerrno>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <limits>
+#include <stdexcept>
+#include <exception>
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+
+#include "mmio_ops.h"
+#include "matvec.h"
+
+
+struct csrbin_header {
+    char     magic[8];
+    npy_uint32 version;
+    npy_uint32 header_size;
+    char     Ap_dtype[8];
+    char     Aj_dtype[8];
+    char     Ax_dtype[8];
+    npy_int64 n_row;
+    npy_int64 n_col;
+    npy_int64 nnz;
+    npy_uint32 flags;
+    npy_uint32 reserved;
+    npy_uint64 offset[3];
+    npy_uint64 size[3];
+    npy_uint64 checksum[3];
+    npy_uint64 header_checksum;
+};
+
+ct_assert(sizeof(csrbin_header) == 152);
+
+#define CSRBIN_MAGIC     "CRPYCSR"
+#define CSRBIN_VERSION   1
+#define CSRBIN_ALIGNMENT 4096
+#define CSRBIN_CANONICAL 1
+
+
+/*
+ * numpy type string of T, e.g. "<i4", "|i1" or "<c16"
+ */
+template <class T>
+struct csrbin_dtype {
+    static std::string str(){
+        const char kind = !std::numeric_limits<T>::is_integer ? 'f' :
+                          (std::numeric_limits<T>::is_signed ? 'i' : 'u');
+        char buf[8];
+        snprintf(buf, sizeof(buf), "%c%c%d", sizeof(T) == 1 ? '|' : '<', kind, (int)sizeof(T));
+        return buf;
+    }
+};
+
+template <>
+struct csrbin_dtype<npy_bool_wrapper> {
+    static std::string str(){ return "|b1"; }
+};
+
+template <class c_type, class npy_type>
+struct csrbin_dtype< complex_wrapper<c_type,npy_type> > {
+    static std::string str(){
+        char buf[8];
+        snprintf(buf, sizeof(buf), "<c%d", (int)(2 * sizeof(c_type)));
+        return buf;
+    }
+};
+
+
+/*
+ * Checksum of nbytes at data, zero-padded to whole 64-bit words
+ */
+inline npy_uint64 csrbin_checksum(const void * data, const npy_uint64 nbytes)
+{
+    const unsigned char * bytes = (const unsigned char *)data;
+    const npy_intp n_words = (npy_intp)(nbytes / 8);
+
+    npy_uint64 sum = 0;
+    #pragma omp parallel for schedule(static) reduction(+:sum) if(n_words > parallel_threshold)
+    for(npy_intp k = 0; k < n_words; k++){
+        npy_uint64 w;
+        memcpy(&w, bytes + 8 * k, 8);
+        sum += (2 * (npy_uint64)k + 1) * w;
+    }
+
+    if(nbytes % 8){
+        npy_uint64 w = 0;
+        memcpy(&w, bytes + 8 * n_words, nbytes % 8);
+        sum += (2 * (npy_uint64)n_words + 1) * w;
+    }
+    return sum;
+}
+
+
+inline bool csrbin_little_endian(){
+    const npy_uint32 one = 1;
+    return *(const unsigned char *)&one == 1;
+}
+
+
+/*
+ * Write CSR matrix A to a binary container
+ *
+ * Input Arguments:
+ *   char filename    - path of the file
+ *   I  n_row         - number of rows in A
+ *   I  n_col         - number of columns in A
+ *   P  Ap[n_row+1]   - row pointer
+ *   I  Aj[nnz(A)]    - column indices
+ *   T  Ax[nnz(A)]    - nonzeros
+ *
+ * Note:
+ *   The canonical flag is set when the column indices of every row
+ *   are sorted and unique.
+ *
+ *   Loaders only avoid a copy when the stored dtypes are the ones the
+ *   kernels are instantiated for, so Ap is best written with P = I
+ *   unless nnz(A) needs the wider type.
+ *
+ */
+template <class I, class T, class P>
+void csr_write_binary(const char * filename,
+                      const I n_row,
+                      const I n_col,
+                      const P Ap[],
+                      const I Aj[],
+                      const T Ax[])
+{
+    if(!csrbin_little_endian()){
+        throw std::runtime_error("binary CSR files are only supported on little-endian hosts");
+    }
+
+    const npy_intp nnz = Ap[n_row];
+
+    bool canonical = true;
+    #pragma omp parallel for schedule(static) reduction(&&:canonical) if(nnz > parallel_threshold)
+    for(I i = 0; i < n_row; i++){
+        for(P jj = Ap[i] + 1; jj < Ap[i+1]; jj++){
+            canonical = canonical && (Aj[jj-1] < Aj[jj]);
+        }
+    }
+
+    csrbin_header h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, CSRBIN_MAGIC, sizeof(CSRBIN_MAGIC));
+    h.version     = CSRBIN_VERSION;
+    h.header_size = sizeof(csrbin_header);
+    strncpy(h.Ap_dtype, csrbin_dtype<P>::str().c_str(), 7);
+    strncpy(h.Aj_dtype, csrbin_dtype<I>::str().c_str(), 7);
+    strncpy(h.Ax_dtype, csrbin_dtype<T>::str().c_str(), 7);
+    h.n_row = n_row;
+    h.n_col = n_col;
+    h.nnz   = nnz;
+    h.flags = canonical ? CSRBIN_CANONICAL : 0;
+
+    const void * section[3] = { Ap, Aj, Ax };
+    h.size[0] = (npy_uint64)(n_row + 1) * sizeof(P);
+    h.size[1] = (npy_uint64)nnz * sizeof(I);
+    h.size[2] = (npy_uint64)nnz * sizeof(T);
+
+    npy_uint64 offset = sizeof(csrbin_header);
+    for(int s = 0; s < 3; s++){
+        offset = (offset + CSRBIN_ALIGNMENT - 1) / CSRBIN_ALIGNMENT * CSRBIN_ALIGNMENT;
+        h.offset[s]   = offset;
+        h.checksum[s] = csrbin_checksum(section[s], h.size[s]);
+        offset += h.size[s];
+    }
+    h.header_checksum = csrbin_checksum(&h, offsetof(csrbin_header, header_checksum));
+
+    FILE * f = fopen(filename, "wb");
+    if(!f){
+        throw std::runtime_error(std::string("cannot open ") + filename);
+    }
+
+    bool ok = fwrite(&h, sizeof(h), 1, f) == 1;
+    npy_uint64 pos = sizeof(h);
+    const char zeros[CSRBIN_ALIGNMENT] = {0};
+    for(int s = 0; s < 3 && ok; s++){
+        ok = fwrite(zeros, 1, h.offset[s] - pos, f) == h.offset[s] - pos;
+        ok = ok && fwrite(section[s], 1, h.size[s], f) == h.size[s];
+        pos = h.offset[s] + h.size[s];
+        const npy_uint64 pad = (8 - pos % 8) % 8;
+        ok = ok && fwrite(zeros, 1, pad, f) == pad;
+        pos += pad;
+    }
+
+    if(fclose(f) != 0 || !ok){
+        throw std::runtime_error(std::string("cannot write ") + filename);
+    }
+}
+
+
+/*
+ * Check a header read from a file of file_size bytes, and that the
+ * file holds Ap, Aj and Ax of types P, I and T
+ */
+template <class I, class T, class P>
+void csrbin_check_header(const csrbin_header& h, const npy_uint64 file_size)
+{
+    if(memcmp(h.magic, CSRBIN_MAGIC, sizeof(CSRBIN_MAGIC)) != 0){
+        throw std::invalid_argument("not a binary CSR file");
+    }
+    if(h.version != CSRBIN_VERSION || h.header_size != sizeof(csrbin_header) ||
+       h.header_checksum != csrbin_checksum(&h, offsetof(csrbin_header, header_checksum))){
+        throw std::invalid_argument("unsupported or corrupt binary CSR header");
+    }
+    if(!csrbin_little_endian()){
+        throw std::runtime_error("binary CSR files are only supported on little-endian hosts");
+    }
+    if(csrbin_dtype<P>::str() != h.Ap_dtype ||
+       csrbin_dtype<I>::str() != h.Aj_dtype ||
+       csrbin_dtype<T>::str() != h.Ax_dtype){
+        throw std::invalid_argument(std::string("binary CSR file holds (") + h.Ap_dtype +
+                                    ", " + h.Aj_dtype + ", " + h.Ax_dtype + ")");
+    }
+    if(h.n_row > std::numeric_limits<I>::max() || h.n_col > std::numeric_limits<I>::max()){
+        throw std::overflow_error("matrix dimensions do not fit in the index type");
+    }
+    if(h.size[0] != (npy_uint64)(h.n_row + 1) * sizeof(P) ||
+       h.size[1] != (npy_uint64)h.nnz * sizeof(I) ||
+       h.size[2] != (npy_uint64)h.nnz * sizeof(T)){
+        throw std::invalid_argument("inconsistent binary CSR header");
+    }
+    for(int s = 0; s < 3; s++){
+        if(h.offset[s] % CSRBIN_ALIGNMENT != 0 || h.offset[s] + h.size[s] > file_size){
+            throw std::invalid_argument("truncated binary CSR file");
+        }
+    }
+}
+
+
+/*
+ * Read the header of a binary container, checking only the magic
+ */
+inline csrbin_header csrbin_read_header(const char * filename)
+{
+    csrbin_header h;
+    FILE * f = fopen(filename, "rb");
+    if(!f){
+        throw std::runtime_error(std::string("cannot open ") + filename);
+    }
+    const bool ok = fread(&h, sizeof(h), 1, f) == 1;
+    fclose(f);
+    if(!ok || memcmp(h.magic, CSRBIN_MAGIC, sizeof(CSRBIN_MAGIC)) != 0){
+        throw std::invalid_argument("not a binary CSR file");
+    }
+    return h;
+}
+
+
+/*
+ * CSR matrix memory-mapped from a binary container
+ *
+ * Ap(), Aj() and Ax() point into the mapping, which lives as long as
+ * the object; nothing is copied, and processes mapping the same file
+ * share its pages through the page cache.  The stored dtypes must match
+ * I, T and P.  With verify set the section checksums are checked,
+ * which reads the whole file once.
+ *
+ */
+template <class I, class T, class P>
+class csr_binary_file {
+    public:
+        explicit csr_binary_file(const char * filename, const bool verify = false)
+            : file_(filename, false)
+        {
+            const npy_uint64 file_size = (npy_uint64)(file_.end() - file_.begin());
+            if(file_size < sizeof(csrbin_header)){
+                throw std::invalid_argument("not a binary CSR file");
+            }
+            memcpy(&h_, file_.begin(), sizeof(h_));
+            csrbin_check_header<I,T,P>(h_, file_size);
+
+            for(int s = 0; s < 3 && verify; s++){
+                if(csrbin_checksum(file_.begin() + h_.offset[s], h_.size[s]) != h_.checksum[s]){
+                    throw std::invalid_argument("binary CSR checksum mismatch");
+                }
+            }
+        }
+
+        I n_row() const { return (I)h_.n_row; }
+        I n_col() const { return (I)h_.n_col; }
+        npy_intp nnz() const { return (npy_intp)h_.nnz; }
+        bool canonical() const { return (h_.flags & CSRBIN_CANONICAL) != 0; }
+
+        const P * Ap() const { return (const P *)(file_.begin() + h_.offset[0]); }
+        const I * Aj() const { return (const I *)(file_.begin() + h_.offset[1]); }
+        const T * Ax() const { return (const T *)(file_.begin() + h_.offset[2]); }
+
+    private:
+        mm_mapped_file file_;
+        csrbin_header h_;
+};
+
+/*
+ * Timings of csr_matvec_binary, in seconds
+ *
+ * The fraction of the disk time hidden behind computation is
+ * 1 - stall / read.  stall also counts the hand-off between the
+ * threads, which dominates for blocks much smaller than a megabyte.
+ */
+struct csrbin_stream_stats {
+    double wall;            // whole call
+    double read;            // reader thread busy reading blocks
+    double compute;         // SpMV on the blocks
+    double stall;           // SpMV waiting for a block to arrive
+    npy_uint64 bytes;       // bytes of Aj and Ax read
+    npy_intp n_blocks;
+};
+
+
+/*
+ * Read exactly nbytes at offset of file fd
+ */
+inline void csrbin_pread(const int fd, void * buf, npy_uint64 nbytes, npy_uint64 offset)
+{
+    char * p = (char *)buf;
+    while(nbytes > 0){
+        const ssize_t n = pread(fd, p, nbytes, (off_t)offset);
+        if(n < 0 && errno == EINTR){
+            continue;
+        }
+        if(n <= 0){
+            throw std::runtime_error("cannot read binary CSR file");
+        }
+        p += n;
+        nbytes -= n;
+        offset += n;
+    }
+}
+
+
+/*
+ * Compute Y += A*X for CSR matrix A stored in a binary container,
+ * streaming A from disk
+ *
+ * Input Arguments:
+ *   char filename    - path of the binary CSR file
+ *   T  Xx[n_col]     - input vector
+ *   npy_intp block_bytes - target size of a block of Aj and Ax in memory
+ *
+ * Output Arguments:
+ *   T  Yx[n_row]     - output vector
+ *   csrbin_stream_stats stats - timings (may be NULL)
+ *
+ * Note:
+ *   Output array Yx must be preallocated
+ *
+ *   Only Ap, X, Y and two blocks of about block_bytes each are held in
+ *   memory.  A reader thread fills one block (contiguous rows, read
+ *   with pread) while the other is multiplied, row-parallel, so disk
+ *   and computation overlap; a block is reused as soon as its product
+ *   is done.  Ap and the column indices of each block are checked as
+ *   they are read, so a corrupt file raises instead of indexing out
+ *   of bounds.  Files that fit in memory are better mapped with
+ *   csr_binary_file and passed to csr_matvec.
+ *
+ */
+template <class I, class T, class P>
+void csr_matvec_binary(const char * filename,
+                       const T Xx[],
+                             T Yx[],
+                       const npy_intp block_bytes,
+                       csrbin_stream_stats * stats)
+{
+    typedef std::chrono::steady_clock clock;
+    const clock::time_point t_start = clock::now();
+
+    struct file_descriptor {
+        int fd;
+        explicit file_descriptor(const char * filename) : fd(open(filename, O_RDONLY)) {}
+        ~file_descriptor(){ if(fd >= 0) close(fd); }
+    } file(filename);
+
+    struct stat st;
+    if(file.fd < 0 || fstat(file.fd, &st) != 0){
+        throw std::runtime_error(std::string("cannot open ") + filename);
+    }
+    if((npy_uint64)st.st_size < sizeof(csrbin_header)){
+        throw std::invalid_argument("not a binary CSR file");
+    }
+
+    csrbin_header h;
+    csrbin_pread(file.fd, &h, sizeof(h), 0);
+    csrbin_check_header<I,T,P>(h, (npy_uint64)st.st_size);
+
+    const I n_row = (I)h.n_row;
+    std::vector<P> Ap(n_row + 1);
+    csrbin_pread(file.fd, Ap.data(), h.size[0], h.offset[0]);
+
+    // The blocks are sized and read from Ap, so it must be a valid
+    // row pointer before anything is allocated from it.
+    if(Ap[0] != 0 || (npy_int64)Ap[n_row] != h.nnz){
+        throw std::invalid_argument("corrupt binary CSR row pointer");
+    }
+    for(I i = 0; i < n_row; i++){
+        if(Ap[i+1] < Ap[i]){
+            throw std::invalid_argument("corrupt binary CSR row pointer");
+        }
+    }
+    const I n_col = (I)h.n_col;
+
+    // Split the rows into blocks of about block_bytes.
+    const npy_intp block_nnz = std::max<npy_intp>(1, block_bytes / (npy_intp)(sizeof(I) + sizeof(T)));
+    std::vector<I> bounds(1, 0);
+    npy_intp max_nnz = 0;
+    while(bounds.back() < n_row){
+        const I r0 = bounds.back();
+        I r1 = (I)(std::upper_bound(Ap.begin() + r0, Ap.end() - 1, (npy_intp)Ap[r0] + block_nnz) - Ap.begin());
+        r1 = std::max<I>(r1, r0 + 1);
+        bounds.push_back(r1);
+        max_nnz = std::max<npy_intp>(max_nnz, Ap[r1] - Ap[r0]);
+    }
+    const npy_intp n_blocks = (npy_intp)bounds.size() - 1;
+
+    std::vector<I> Bj[2];
+    std::vector<T> Bx[2];
+    for(int b = 0; b < 2; b++){
+        Bj[b].resize(max_nnz);
+        Bx[b].resize(max_nnz);
+    }
+
+    // filled[b]: block held by buffer b, or -1 when it may be refilled
+    std::mutex m;
+    std::condition_variable cv;
+    npy_intp filled[2] = {-1, -1};
+    bool failed = false;
+    std::exception_ptr error;
+    double t_read = 0;
+
+    std::thread reader([&](){
+        try {
+            for(npy_intp k = 0; k < n_blocks; k++){
+                const int b = (int)(k % 2);
+                {
+                    std::unique_lock<std::mutex> lock(m);
+                    cv.wait(lock, [&](){ return filled[b] == -1; });
+                }
+
+                const clock::time_point t0 = clock::now();
+                const npy_uint64 start = Ap[bounds[k]];
+                const npy_uint64 len   = Ap[bounds[k+1]] - Ap[bounds[k]];
+                if(len > 0){
+                    csrbin_pread(file.fd, Bj[b].data(), len * sizeof(I), h.offset[1] + start * sizeof(I));
+                    csrbin_pread(file.fd, Bx[b].data(), len * sizeof(T), h.offset[2] + start * sizeof(T));
+                }
+                for(npy_uint64 n = 0; n < len; n++){
+                    if(Bj[b][n] < 0 || Bj[b][n] >= n_col){
+                        throw std::invalid_argument("column index out of range in binary CSR file");
+                    }
+                }
+                t_read += std::chrono::duration<double>(clock::now() - t0).count();
+
+                std::lock_guard<std::mutex> lock(m);
+                filled[b] = k;
+                cv.notify_all();
+            }
+        } catch (...) {
+            // rethrown as is by the caller's thread below
+            std::lock_guard<std::mutex> lock(m);
+            failed = true;
+            error = std::current_exception();
+            cv.notify_all();
+        }
+    });
+
+    double t_compute = 0, t_stall = 0;
+    for(npy_intp k = 0; k < n_blocks; k++){
+        const int b = (int)(k % 2);
+
+        const clock::time_point t0 = clock::now();
+        {
+            std::unique_lock<std::mutex> lock(m);
+            cv.wait(lock, [&](){ return filled[b] == k || failed; });
+            if(failed){
+                break;
+            }
+        }
+        const clock::time_point t1 = clock::now();
+
+        const I r0 = bounds[k];
+        const I r1 = bounds[k+1];
+        const P base = Ap[r0];
+        const I * Aj = Bj[b].data();
+        const T * Ax = Bx[b].data();
+
+        #pragma omp parallel for schedule(static) if(Ap[r1] - base > parallel_threshold)
+        for(I i = r0; i < r1; i++){
+            T sum = Yx[i];
+            for(P jj = Ap[i] - base; jj < Ap[i+1] - base; jj++){
+                sum += Ax[jj] * Xx[Aj[jj]];
+            }
+            Yx[i] = sum;
+        }
+
+        const clock::time_point t2 = clock::now();
+        t_stall   += std::chrono::duration<double>(t1 - t0).count();
+        t_compute += std::chrono::duration<double>(t2 - t1).count();
+
+        std::lock_guard<std::mutex> lock(m);
+        filled[b] = -1;
+        cv.notify_all();
+    }
+
+    reader.join();
+    if(failed){
+        std::rethrow_exception(error);
+    }
+
+    if(stats){
+        stats->wall     = std::chrono::duration<double>(clock::now() - t_start).count();
+        stats->read     = t_read;
+        stats->compute  = t_compute;
+        stats->stall    = t_stall;
+        stats->bytes    = (npy_uint64)h.nnz * (sizeof(I) + sizeof(T));
+        stats->n_blocks = n_blocks;
+    }
+}
+
+#endif
@@ -0,0 +1,61 @@
+#ifndef __DENSE_H__
+#define __DENSE_H__
+
+/*
+ * Small dense kernels (BLAS-1/BLAS-2/BLAS-3 style) used by the
+ * sparse routines.  All arrays are C-contiguous.
+ */
+
+// y += a*x
+template <class I, class T>
+void axpy(const I n, const T a, const T * x, T * y){
+    for(I i = 0; i < n; i++){
+        y[i] += a * x[i];
+    }
+}
+
+// x *= a
+template <class I, class T>
+void scal(const I n, const T a, T * x){
+    for(I i = 0; i < n; i++){
+        x[i] *= a;
+    }
+}
+
+// dot product x'y
+template <class I, class T>
+T dot(const I n, const T * x, const T * y){
+    T dp = 0;
+    for(I i = 0; i < n; i++){
+        dp += x[i] * y[i];
+    }
+    return dp;
+}
+
+// y += A*x, A is (m,n)
+template <class I, class T>
+void gemv(const I m, const I n, const T * A, const T * x, T * y){
+    for(I i = 0; i < m; i++){
+        T dot = y[i];
+        for(I j = 0; j < n; j++){
+            dot += A[(npy_intp)n * i + j] * x[j];
+        }
+        y[i] = dot;
+    }
+}
+
+// C += A*B, A is (M,K), B is (K,N), C is (M,N)
+template <class I, class T>
+void gemm(const I M, const I N, const I K, const T * A, const T * B, T * C){
+    for(I i = 0; i < M; i++){
+        for(I j = 0; j < N; j++){
+            T dot = C[(npy_intp)N * i + j];
+            for(I k = 0; k < K; k++){
+                dot += A[(npy_intp)K * i + k] * B[(npy_intp)N * k + j];
+            }
+            C[(npy_intp)N * i + j] = dot;
+        }
+    }
+}
+
+#endif
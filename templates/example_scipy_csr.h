@@ -5,9 +5,15 @@
 #include <vector>
 #include <algorithm>
 #include <functional>
+#include <limits>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 #include "util.h"
 #include "dense.h"
+#include "csr_binop.h"
 
 /*
  * Extract main diagonal of CSR matrix A
@@ -301,11 +307,6 @@ bool csr_has_canonical_format(const I n_row,
 }
 
 
-template< class T1, class T2 >
-bool kv_pair_less(const std::pair<T1,T2>& x, const std::pair<T1,T2>& y){
-    return x.first < y.first;
-}
-
 /*
  * Sort CSR column indices inplace
  *
@@ -346,84 +347,6 @@ void csr_sort_indices(const I n_row,
 
 
 
-/*
- * Compute B = A for CSR matrix A, CSC matrix B
- *
- * Also, with the appropriate arguments can also be used to:
- *   - compute B = A^t for CSR matrix A, CSR matrix B
- *   - compute B = A^t for CSC matrix A, CSC matrix B
- *   - convert CSC->CSR
- *
- * Input Arguments:
- *   I  n_row         - number of rows in A
- *   I  n_col         - number of columns in A
- *   I  Ap[n_row+1]   - row pointer
- *   I  Aj[nnz(A)]    - column indices
- *   T  Ax[nnz(A)]    - nonzeros
- *
- * Output Arguments:
- *   I  Bp[n_col+1] - column pointer
- *   I  Bj[nnz(A)]  - row indices
- *   T  Bx[nnz(A)]  - nonzeros
- *
- * Note:
- *   Output arrays Bp, Bj, Bx must be preallocated
- *
- * Note: 
- *   Input:  column indices *are not* assumed to be in sorted order
- *   Output: row indices *will be* in sorted order
- *
- *   Complexity: Linear.  Specifically O(nnz(A) + max(n_row,n_col))
- * 
- */
-template <class I, class T>
-void csr_tocsc(const I n_row,
-	           const I n_col, 
-	           const I Ap[], 
-	           const I Aj[], 
-	           const T Ax[],
-	                 I Bp[],
-	                 I Bi[],
-	                 T Bx[])
-{  
-    const I nnz = Ap[n_row];
-
-    //compute number of non-zero entries per column of A 
-    std::fill(Bp, Bp + n_col, 0);
-
-    for (I n = 0; n < nnz; n++){            
-        Bp[Aj[n]]++;
-    }
-
-    //cumsum the nnz per column to get Bp[]
-    for(I col = 0, cumsum = 0; col < n_col; col++){     
-        I temp  = Bp[col];
-        Bp[col] = cumsum;
-        cumsum += temp;
-    }
-    Bp[n_col] = nnz; 
-
-    for(I row = 0; row < n_row; row++){
-        for(I jj = Ap[row]; jj < Ap[row+1]; jj++){
-            I col  = Aj[jj];
-            I dest = Bp[col];
-
-            Bi[dest] = row;
-            Bx[dest] = Ax[jj];
-
-            Bp[col]++;
-        }
-    }  
-
-    for(I col = 0, last = 0; col <= n_col; col++){
-        I temp  = Bp[col];
-        Bp[col] = last;
-        last    = temp;
-    }
-}   
-
-
-
 /*
  * Compute B = A for CSR matrix A, ELL matrix B
  *
@@ -473,164 +396,6 @@ void csr_toell(const I n_row,
 }
 
 
-/*
- * Compute C = A*B for CSR matrices A,B
- *
- *
- * Input Arguments:
- *   I  n_row       - number of rows in A
- *   I  n_col       - number of columns in B (hence C is n_row by n_col)
- *   I  Ap[n_row+1] - row pointer
- *   I  Aj[nnz(A)]  - column indices
- *   T  Ax[nnz(A)]  - nonzeros
- *   I  Bp[?]       - row pointer
- *   I  Bj[nnz(B)]  - column indices
- *   T  Bx[nnz(B)]  - nonzeros
- * Output Arguments:
- *   I  Cp[n_row+1] - row pointer
- *   I  Cj[nnz(C)]  - column indices
- *   T  Cx[nnz(C)]  - nonzeros
- *   
- * Note:
- *   Output arrays Cp, Cj, and Cx must be preallocated
- *   The value of nnz(C) will be stored in Ap[n_row] after the first pass.
- *
- * Note: 
- *   Input:  A and B column indices *are not* assumed to be in sorted order 
- *   Output: C column indices *are not* assumed to be in sorted order
- *           Cx will not contain any zero entries
- *
- *   Complexity: O(n_row*K^2 + max(n_row,n_col)) 
- *                 where K is the maximum nnz in a row of A
- *                 and column of B.
- *
- *
- *  This is an implementation of the SMMP algorithm:
- *
- *    "Sparse Matrix Multiplication Package (SMMP)"
- *      Randolph E. Bank and Craig C. Douglas
- *
- *    http://citeseer.ist.psu.edu/445062.html
- *    http://www.mgnet.org/~douglas/ccd-codes.html
- *
- */
-
-
-/*
- * Pass 1 computes CSR row pointer for the matrix product C = A * B
- *
- */
-template <class I>
-void csr_matmat_pass1(const I n_row,
-                      const I n_col, 
-                      const I Ap[], 
-                      const I Aj[], 
-                      const I Bp[],
-                      const I Bj[],
-                            I Cp[])
-{
-    // method that uses O(n) temp storage
-    std::vector<I> mask(n_col, -1);
-    Cp[0] = 0;
-
-    I nnz = 0;
-    for(I i = 0; i < n_row; i++){
-        npy_intp row_nnz = 0;
-
-        for(I jj = Ap[i]; jj < Ap[i+1]; jj++){
-            I j = Aj[jj];
-            for(I kk = Bp[j]; kk < Bp[j+1]; kk++){
-                I k = Bj[kk];
-                if(mask[k] != i){
-                    mask[k] = i;                        
-                    row_nnz++;
-                }
-            }
-        }
-
-        npy_intp next_nnz = nnz + row_nnz;
-
-        if (row_nnz > NPY_MAX_INTP - nnz || next_nnz != (I)next_nnz) {
-            /*
-             * Index overflowed. Note that row_nnz <= n_col and cannot overflow
-             */
-            throw std::overflow_error("nnz of the result is too large");
-        }
-
-        nnz = next_nnz;
-        Cp[i+1] = nnz;
-    }
-}
-
-/*
- * Pass 2 computes CSR entries for matrix C = A*B using the 
- * row pointer Cp[] computed in Pass 1.
- *
- */
-template <class I, class T>
-void csr_matmat_pass2(const I n_row,
-      	              const I n_col, 
-      	              const I Ap[], 
-      	              const I Aj[], 
-      	              const T Ax[],
-      	              const I Bp[],
-      	              const I Bj[],
-      	              const T Bx[],
-      	                    I Cp[],
-      	                    I Cj[],
-      	                    T Cx[])
-{
-    std::vector<I> next(n_col,-1);
-    std::vector<T> sums(n_col, 0);
-
-    I nnz = 0;
-
-    Cp[0] = 0;
-
-    for(I i = 0; i < n_row; i++){
-        I head   = -2;
-        I length =  0;
-
-        I jj_start = Ap[i];
-        I jj_end   = Ap[i+1];
-        for(I jj = jj_start; jj < jj_end; jj++){
-            I j = Aj[jj];
-            T v = Ax[jj];
-
-            I kk_start = Bp[j];
-            I kk_end   = Bp[j+1];
-            for(I kk = kk_start; kk < kk_end; kk++){
-                I k = Bj[kk];
-
-                sums[k] += v*Bx[kk];
-
-                if(next[k] == -1){
-                    next[k] = head;                        
-                    head  = k;
-                    length++;
-                }
-            }
-        }         
-
-        for(I jj = 0; jj < length; jj++){
-
-            if(sums[head] != 0){
-                Cj[nnz] = head;
-                Cx[nnz] = sums[head];
-                nnz++;
-            }
-
-            I temp = head;                
-            head = next[head];
-
-            next[temp] = -1; //clear arrays
-            sums[temp] =  0;                              
-        }
-
-        Cp[i+1] = nnz;
-    }
-}
-
 /* element-wise binary operations*/
 template <class I, class T, class T2>
 void csr_ne_csr(const I n_row, const I n_col, 
@@ -820,88 +585,6 @@ void csr_eliminate_zeros(const I n_row,
 }
 
 
-
-/*
- * Compute Y += A*X for CSR matrix A and dense vectors X,Y
- *
- *
- * Input Arguments:
- *   I  n_row         - number of rows in A
- *   I  n_col         - number of columns in A
- *   I  Ap[n_row+1]   - row pointer
- *   I  Aj[nnz(A)]    - column indices
- *   T  Ax[nnz(A)]    - nonzeros
- *   T  Xx[n_col]     - input vector
- *
- * Output Arguments:
- *   T  Yx[n_row]     - output vector
- *
- * Note:
- *   Output array Yx must be preallocated
- *
- *   Complexity: Linear.  Specifically O(nnz(A) + n_row)
- * 
- */
-template <class I, class T>
-void csr_matvec(const I n_row,
-	            const I n_col, 
-	            const I Ap[], 
-	            const I Aj[], 
-	            const T Ax[],
-	            const T Xx[],
-	                  T Yx[])
-{
-    for(I i = 0; i < n_row; i++){
-        T sum = Yx[i];
-        for(I jj = Ap[i]; jj < Ap[i+1]; jj++){
-            sum += Ax[jj] * Xx[Aj[jj]];
-        }
-        Yx[i] = sum;
-    }
-}
-
-
-/*
- * Compute Y += A*X for CSR matrix A and dense block vectors X,Y
- *
- *
- * Input Arguments:
- *   I  n_row            - number of rows in A
- *   I  n_col            - number of columns in A
- *   I  n_vecs           - number of column vectors in X and Y
- *   I  Ap[n_row+1]      - row pointer
- *   I  Aj[nnz(A)]       - column indices
- *   T  Ax[nnz(A)]       - nonzeros
- *   T  Xx[n_col,n_vecs] - input vector
- *
- * Output Arguments:
- *   T  Yx[n_row,n_vecs] - output vector
- *
- */
-template <class I, class T>
-void csr_matvecs(const I n_row,
-	             const I n_col, 
-                 const I n_vecs,
-	             const I Ap[], 
-	             const I Aj[], 
-	             const T Ax[],
-	             const T Xx[],
-	                   T Yx[])
-{
-    for(I i = 0; i < n_row; i++){
-        T * y = Yx + (npy_intp)n_vecs * i;
-        for(I jj = Ap[i]; jj < Ap[i+1]; jj++){
-            const I j = Aj[jj];
-            const T a = Ax[jj];
-            const T * x = Xx + (npy_intp)n_vecs * j;
-            axpy(n_vecs, a, x, y);
-        }
-    }
-}
-
-
-
-
 template<class I, class T>
 void get_csr_submatrix(const I n_row,
 		               const I n_col,
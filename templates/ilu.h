@@ -0,0 +1,207 @@
+#ifndef __ILU_H__
+#define __ILU_H__
+
+/*
+ * Incomplete LU factorizations of CSR matrices: ILU(0), on the pattern
+ * of A, and ILU(k), on the pattern of A with the fill of level k or
+ * less.
+ *
+ * Both factors are stored in place of A, as one CSR matrix L\U: the
+ * strictly lower entries are L, whose diagonal of ones is not stored,
+ * and the diagonal and upper entries are U.  That matrix is solved as
+ * it is by csr_trsv(..., lower=1, unit=1, ...) and then
+ * csr_trsv(..., lower=0, unit=0, ...).
+ *
+ * Row i of the factorization reads the finished rows j < i of its
+ * lower pattern, the same dependencies as the lower triangular solve.
+ * So it is parallelized by the levels from csr_trsv_analysis(...,
+ * lower=1, ...), which are then used again for the L solves.
+ *
+ * ILU(k) is ILU(0) on a larger pattern: csr_iluk_pass1 and
+ * csr_iluk_pass2 compute the pattern, as csr_matmat_pass1 and
+ * csr_matmat_pass2 do for a product, and csr_ilu0 factors it.
+ *
+ * The row factorization and the symbolic ILU(k) pass, with their
+ * functors, are in ilu_ops.h.
+ */
+
+#include <vector>
+#include <algorithm>
+#include <stdexcept>
+
+#include "triangular.h"
+#include "ilu_ops.h"
+
+
+/*
+ * Incomplete LU factorization with zero fill, ILU(0), of CSR matrix A
+ *
+ *
+ * Input Arguments:
+ *   I  n_row         - number of rows (and columns) in A
+ *   I  Ap[n_row+1]   - row pointer
+ *   I  Aj[nnz(A)]    - column indices
+ *   I  n_levels      - handle from csr_trsv_analysis(..., lower=1, ...)
+ *   I  level_ptr[n_levels+1]
+ *   I  level_rows[n_row]
+ *
+ * Input/Output Arguments:
+ *   T  Ax[nnz(A)]    - A on input, L\U on output
+ *
+ * Note:
+ *   A must have sorted column indices, no duplicates, and every
+ *   diagonal entry (see csr_has_canonical_format and csr_sort_indices);
+ *   otherwise std::invalid_argument is thrown and Ax is unchanged.
+ *   The pattern of an ILU(k) from csr_iluk_pass2 always is.
+ *
+ *   L*U equals A at every entry of the pattern of A.  No pivoting is
+ *   done: std::domain_error is thrown if a pivot U[i,i] is zero, after
+ *   the other rows are factored.
+ *
+ *   The level handle is the one for the L solves with the factors,
+ *   since it only depends on the pattern.  Rows of a level are
+ *   factored in parallel; the factors are the same as serially.
+ *
+ *   Complexity: O(sum over the entries (i,k) of L of nnz(A[i,:]) +
+ *   nnz(U[k,:])), with one barrier per level that has at least 64 rows
+ *   per thread
+ *
+ */
+template <class I, class T>
+void csr_ilu0(const I n_row,
+              const I Ap[],
+              const I Aj[],
+                    T Ax[],
+              const I n_levels,
+              const I level_ptr[],
+              const I level_rows[])
+{
+    std::vector<I> diag(n_row);
+    I n_bad = 0;
+
+    #pragma omp parallel for schedule(static) reduction(+:n_bad) if(Ap[n_row] > parallel_threshold)
+    for(I i = 0; i < n_row; i++){
+        diag[i] = -1;
+        for(I jj = Ap[i]; jj < Ap[i+1]; jj++){
+            if(jj > Ap[i] && !(Aj[jj-1] < Aj[jj])){
+                diag[i] = -1;
+                break;
+            }
+            if(Aj[jj] == i){
+                diag[i] = jj;
+            }
+        }
+        if(diag[i] < 0){
+            n_bad++;
+        }
+    }
+    if(n_bad > 0){
+        throw std::invalid_argument("csr_ilu0: A needs sorted indices, no duplicates, and a full diagonal");
+    }
+
+    csr_ilu0_factor<I,T> factor_row;
+    factor_row.Ap = Ap;
+    factor_row.Aj = Aj;
+    factor_row.Ax = Ax;
+    factor_row.diag = diag.data();
+
+    const I zero_row = csr_trsv_levels(n_row, (I)1, n_levels, level_ptr, level_rows,
+                                       Ap[n_row] > parallel_threshold,
+                                       factor_row);
+    if(zero_row >= 0){
+        throw std::domain_error("csr_ilu0: zero pivot");
+    }
+}
+
+
+/*
+ * Pass 1 computes the CSR row pointer of the ILU(k) pattern of A
+ *
+ *
+ * Input Arguments:
+ *   I  n_row         - number of rows (and columns) in A
+ *   I  Ap[n_row+1]   - row pointer
+ *   I  Aj[nnz(A)]    - column indices
+ *   I  fill          - level of fill k, k >= 0
+ *
+ * Output Arguments:
+ *   I  Lp[n_row+1]   - row pointer of L\U
+ *
+ * Returns:
+ *   nnz(L\U), the size of Lj and Lx for pass 2
+ *
+ * Note:
+ *   Output arrays must be preallocated.
+ *
+ *   A may have unsorted indices and duplicates.  The pattern is that
+ *   of A, with the diagonal, and the fill of level k or less, so k = 0
+ *   gives the pattern of ILU(0).
+ *
+ *   Complexity: O(sum over the entries (i,k) of L of nnz(U[k,:]) +
+ *   nnz(L\U) * log), serial
+ *
+ */
+template <class I>
+I csr_iluk_pass1(const I n_row,
+                 const I Ap[],
+                 const I Aj[],
+                 const I fill,
+                       I Lp[])
+{
+    csr_iluk_count<I> emit;
+    emit.Lp = Lp;
+
+    Lp[0] = 0;
+    csr_iluk_symbolic(n_row, Ap, Aj, fill, emit);
+    return Lp[n_row];
+}
+
+
+/*
+ * Pass 2 computes the column indices of the ILU(k) pattern of A and
+ * scatters A into it
+ *
+ *
+ * Input Arguments:
+ *   I  n_row         - number of rows (and columns) in A
+ *   I  Ap[n_row+1]   - row pointer
+ *   I  Aj[nnz(A)]    - column indices
+ *   T  Ax[nnz(A)]    - nonzeros
+ *   I  fill          - level of fill k, as in pass 1
+ *   I  Lp[n_row+1]   - row pointer from csr_iluk_pass1
+ *
+ * Output Arguments:
+ *   I  Lj[nnz(L\U)]  - column indices of L\U, sorted
+ *   T  Lx[nnz(L\U)]  - A, with zeros at the fill; duplicates summed
+ *
+ * Note:
+ *   Output arrays must be preallocated.
+ *
+ *   Lp, Lj, Lx are ready for csr_trsv_analysis(..., lower=1, ...) and
+ *   csr_ilu0, which leaves the ILU(k) factors in Lx.
+ *
+ *   Complexity: as pass 1
+ *
+ */
+template <class I, class T>
+void csr_iluk_pass2(const I n_row,
+                    const I Ap[],
+                    const I Aj[],
+                    const T Ax[],
+                    const I fill,
+                    const I Lp[],
+                          I Lj[],
+                          T Lx[])
+{
+    csr_iluk_fill<I,T> emit;
+    emit.Ap = Ap;
+    emit.Aj = Aj;
+    emit.Ax = Ax;
+    emit.Lp = Lp;
+    emit.Lj = Lj;
+    emit.Lx = Lx;
+
+    csr_iluk_symbolic(n_row, Ap, Aj, fill, emit);
+}
+
+#endif
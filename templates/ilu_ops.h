@@ -0,0 +1,179 @@
+#ifndef __ILU_OPS_H__
+#define __ILU_OPS_H__
+
+/*
+ * The row factorization of csr_ilu0 and the symbolic pass of the
+ * ILU(k) pattern in ilu.h, with the functors that run them.  The
+ * symbolic pass takes an 'emit' functor, which generate_functions.py
+ * cannot wrap, so these are kept out of ilu.h.
+ */
+
+#include <vector>
+#include <algorithm>
+
+
+/*
+ * Factor row i of ILU(0) in place, given the position of the diagonal
+ * of every row
+ *
+ * The columns of row i and of the rows it reads are sorted, so the
+ * update by row k is a merge of row i after column k with row k after
+ * its diagonal.  Returns false if U[i,i] is zero.
+ */
+template <class I, class T>
+inline bool csr_ilu0_row(const I i,
+                         const I Ap[],
+                         const I Aj[],
+                               T Ax[],
+                         const I diag[])
+{
+    const I row_end = Ap[i+1];
+    for(I jj = Ap[i]; jj < diag[i]; jj++){
+        const I k = Aj[jj];
+        const T ukk = Ax[diag[k]];
+        if(ukk == T(0)){
+            // reported by row k
+            continue;
+        }
+        const T lik = T(Ax[jj] / ukk);
+        Ax[jj] = lik;
+
+        I pp = jj + 1;
+        for(I kk = diag[k] + 1; kk < Ap[k+1]; kk++){
+            const I j = Aj[kk];
+            while(pp < row_end && Aj[pp] < j){
+                pp++;
+            }
+            if(pp == row_end){
+                break;
+            }
+            if(Aj[pp] == j){
+                Ax[pp] = Ax[pp] - lik * Ax[kk];
+            }
+        }
+    }
+    return Ax[diag[i]] != T(0);
+}
+
+template <class I, class T>
+struct csr_ilu0_factor {
+    const I * Ap;
+    const I * Aj;
+    T * Ax;
+    const I * diag;
+
+    bool operator()(const I i) const {
+        return csr_ilu0_row(i, Ap, Aj, Ax, diag);
+    }
+};
+
+
+/*
+ * Compute the ILU(k) pattern of CSR matrix A row by row, and call
+ * emit(i, cols) with the sorted columns of row i
+ *
+ * The level of an entry of A or the diagonal is 0, and the level of
+ * the fill that row k makes in row i at column j is
+ * level(i,k) + level(k,j) + 1; the entries of level fill or less are
+ * kept.  The columns of the current row are a linked list in
+ * increasing order, walked while it grows, and the upper part of the
+ * finished rows is kept with its levels.
+ *
+ * The fill of row i depends on its filled lower pattern, which is not
+ * known in advance, so this runs serially.
+ */
+template <class I, class Emit>
+void csr_iluk_symbolic(const I n_row,
+                       const I Ap[],
+                       const I Aj[],
+                       const I fill,
+                             Emit& emit)
+{
+    const I head = n_row;
+    const I end = -1;
+    std::vector<I> next(n_row + 1);
+    std::vector<I> level(n_row, -1);   // -1 if not in the current row
+    std::vector<I> cols;
+    std::vector<I> Up(n_row + 1, 0), Uj, Ul;
+
+    for(I i = 0; i < n_row; i++){
+        cols.assign(Aj + Ap[i], Aj + Ap[i+1]);
+        cols.push_back(i);
+        std::sort(cols.begin(), cols.end());
+        cols.erase(std::unique(cols.begin(), cols.end()), cols.end());
+
+        I prev = head;
+        for(size_t n = 0; n < cols.size(); n++){
+            next[prev] = cols[n];
+            level[cols[n]] = 0;
+            prev = cols[n];
+        }
+        next[prev] = end;
+
+        for(I k = next[head]; k != end && k < i; k = next[k]){
+            const I lik = level[k];
+            prev = k;
+            for(I kk = Up[k]; kk < Up[k+1]; kk++){
+                const I j = Uj[kk];
+                const I l = lik + Ul[kk] + 1;
+                if(l > fill){
+                    continue;
+                }
+                if(level[j] >= 0){
+                    level[j] = std::min(level[j], l);
+                } else {
+                    while(next[prev] != end && next[prev] < j){
+                        prev = next[prev];
+                    }
+                    next[j] = next[prev];
+                    next[prev] = j;
+                    level[j] = l;
+                }
+                prev = j;
+            }
+        }
+
+        cols.clear();
+        for(I j = next[head]; j != end; j = next[j]){
+            cols.push_back(j);
+            if(j > i){
+                Uj.push_back(j);
+                Ul.push_back(level[j]);
+            }
+            level[j] = -1;
+        }
+        Up[i+1] = Uj.size();
+
+        emit(i, cols);
+    }
+}
+
+template <class I>
+struct csr_iluk_count {
+    I * Lp;
+
+    void operator()(const I i, const std::vector<I>& cols) {
+        Lp[i+1] = Lp[i] + (I)cols.size();
+    }
+};
+
+template <class I, class T>
+struct csr_iluk_fill {
+    const I * Ap;
+    const I * Aj;
+    const T * Ax;
+    const I * Lp;
+    I * Lj;
+    T * Lx;
+
+    void operator()(const I i, const std::vector<I>& cols) {
+        std::copy(cols.begin(), cols.end(), Lj + Lp[i]);
+        std::fill(Lx + Lp[i], Lx + Lp[i+1], T(0));
+        for(I jj = Ap[i]; jj < Ap[i+1]; jj++){
+            const I * pos = std::lower_bound(Lj + Lp[i], Lj + Lp[i+1], Aj[jj]);
+            Lx[pos - Lj] += Ax[jj];
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,392 @@
+#ifndef __KRYLOV_H__
+#define __KRYLOV_H__
+
+/*
+ * Krylov solvers for CSR matrices: CG, BiCGStab and restarted GMRES,
+ * each with an optional Jacobi (diagonal) preconditioner.
+ *
+ * The whole iteration runs here, so a solve is one call from Python
+ * with the GIL released for its duration.  Each vector update is fused
+ * with the inner products that follow it, and the matrix-vector
+ * product with the inner product that consumes it, so an iteration
+ * makes as few passes over memory as the recurrences allow: three for
+ * CG and five for BiCGStab and for a GMRES step.
+ *
+ * Every pass splits the rows into schedule(static) blocks (see
+ * static_block in numa_ops.h), so the vectors are processed by the same
+ * threads as the rows of the matrix, and inner products are summed in
+ * thread order: a solve gives the same result on every run with the
+ * same number of threads.
+ *
+ * The passes and their functors are in krylov_ops.h.
+ */
+
+#include <cmath>
+#include <vector>
+
+#include "krylov_ops.h"
+
+
+/*
+ * Solve A*x = b with the conjugate gradient method for Hermitian
+ * positive definite A
+ *
+ *
+ * Input Arguments:
+ *   I  n_row         - number of rows (and columns) in A
+ *   I  Ap[n_row+1]   - row pointer
+ *   I  Aj[nnz(A)]    - column indices
+ *   T  Ax[nnz(A)]    - nonzeros
+ *   T  Bx[n_row]     - right-hand side
+ *   T  tol           - relative tolerance (real part)
+ *   I  maxiter       - maximum number of iterations
+ *   I  jacobi        - nonzero to precondition with diag(A)
+ *
+ * Input/Output Arguments:
+ *   T  Xx[n_row]     - initial guess on entry, solution on exit
+ *
+ * Output Arguments:
+ *   T  resvec[maxiter+1] - residual norms ||b - A*x_k||, k = 0..iters
+ *
+ * Returns:
+ *   the number of iterations, iters.  The solve converged if
+ *   resvec[iters] <= tol*||b||; otherwise it stopped at maxiter or on
+ *   a breakdown (<p,A*p> = 0).
+ *
+ * Note:
+ *   The residual norms are of the unpreconditioned residual, updated
+ *   by the recurrence.  If b = 0 the solution x = 0 is returned with
+ *   iters = 0.
+ *
+ *   Three passes per iteration: q = A*p fused with <p,q>; the x, r
+ *   and z updates fused with <r,r> and <r,z>; and the new direction.
+ *
+ */
+template <class I, class T>
+I csr_cg(const I n_row,
+         const I Ap[],
+         const I Aj[],
+         const T Ax[],
+         const T Bx[],
+               T Xx[],
+         const T tol,
+         const I maxiter,
+         const I jacobi,
+               T resvec[])
+{
+    std::vector<T> Dx;
+    if(jacobi){
+        krylov_jacobi(n_row, Ap, Aj, Ax, Dx);
+    }
+    const T * D = jacobi ? Dx.data() : 0;
+
+    std::vector<T> r(n_row), p(n_row), q(n_row), z(jacobi ? n_row : 0);
+    T * Z = jacobi ? z.data() : r.data();
+
+    // p = z = D*r
+    T sums[3];
+    krylov_sweep(n_row, krylov_residual<I,T>(Ap, Aj, Ax, Bx, Xx, r.data(), p.data(), D), 3, sums);
+    const double bnorm = std::sqrt(real_part(sums[1]));
+    if(bnorm == 0){
+        std::fill(Xx, Xx + n_row, T(0));
+        resvec[0] = 0;
+        return 0;
+    }
+    const double threshold = real_part(tol) * bnorm;
+    resvec[0] = std::sqrt(real_part(sums[0]));
+    T rz = sums[2];
+
+    for(I k = 0; k < maxiter; k++){
+        if(real_part(resvec[k]) <= threshold){
+            return k;
+        }
+
+        krylov_sweep(n_row, krylov_matvec<I,T>(Ap, Aj, Ax, p.data(), q.data(), p.data()), 1, sums);
+        const T pq = sums[0];
+        if(pq == T(0)){
+            return k;
+        }
+
+        krylov_sweep(n_row, cg_update<I,T>(rz / pq, p.data(), q.data(), Xx, r.data(), D, Z), 2, sums);
+        resvec[k+1] = std::sqrt(real_part(sums[0]));
+        if(real_part(resvec[k+1]) <= threshold || rz == T(0)){
+            return k + 1;
+        }
+
+        const T beta = sums[1] / rz;
+        rz = sums[1];
+        krylov_sweep(n_row, cg_direction<I,T>(beta, Z, p.data()), 0, sums);
+    }
+    return maxiter;
+}
+
+
+/*
+ * Solve A*x = b with the stabilized biconjugate gradient method
+ * (BiCGStab) for general A
+ *
+ *
+ * Input Arguments:
+ *   I  n_row         - number of rows (and columns) in A
+ *   I  Ap[n_row+1]   - row pointer
+ *   I  Aj[nnz(A)]    - column indices
+ *   T  Ax[nnz(A)]    - nonzeros
+ *   T  Bx[n_row]     - right-hand side
+ *   T  tol           - relative tolerance (real part)
+ *   I  maxiter       - maximum number of iterations
+ *   I  jacobi        - nonzero to precondition with diag(A)
+ *
+ * Input/Output Arguments:
+ *   T  Xx[n_row]     - initial guess on entry, solution on exit
+ *
+ * Output Arguments:
+ *   T  resvec[maxiter+1] - residual norms ||b - A*x_k||, k = 0..iters
+ *
+ * Returns:
+ *   the number of iterations, iters.  The solve converged if
+ *   resvec[iters] <= tol*||b||; otherwise it stopped at maxiter or on
+ *   a breakdown (rho, <rhat,v>, ||t|| or omega zero).
+ *
+ * Note:
+ *   Preconditioning is from the right, so the residual norms are
+ *   those of the unpreconditioned system.
+ *
+ *   Five passes per iteration, two of them matrix-vector products
+ *   fused with the inner products that use them.
+ *
+ */
+template <class I, class T>
+I csr_bicgstab(const I n_row,
+               const I Ap[],
+               const I Aj[],
+               const T Ax[],
+               const T Bx[],
+                     T Xx[],
+               const T tol,
+               const I maxiter,
+               const I jacobi,
+                     T resvec[])
+{
+    std::vector<T> Dx;
+    if(jacobi){
+        krylov_jacobi(n_row, Ap, Aj, Ax, Dx);
+    }
+    const T * D = jacobi ? Dx.data() : 0;
+
+    std::vector<T> r(n_row), rhat(n_row), p(n_row, T(0)), v(n_row, T(0)), t(n_row);
+    std::vector<T> phat(jacobi ? n_row : 0), shat(jacobi ? n_row : 0);
+    T * Ph = jacobi ? phat.data() : p.data();
+    T * Sh = jacobi ? shat.data() : r.data();
+
+    T sums[3];
+    krylov_sweep(n_row, krylov_residual<I,T>(Ap, Aj, Ax, Bx, Xx, r.data(), rhat.data()), 3, sums);
+    const double bnorm = std::sqrt(real_part(sums[1]));
+    if(bnorm == 0){
+        std::fill(Xx, Xx + n_row, T(0));
+        resvec[0] = 0;
+        return 0;
+    }
+    const double threshold = real_part(tol) * bnorm;
+    resvec[0] = std::sqrt(real_part(sums[0]));
+
+    T rho = 1, alpha = 1, omega = 1;
+    T rho_new = sums[0];
+
+    for(I k = 0; k < maxiter; k++){
+        if(real_part(resvec[k]) <= threshold || rho_new == T(0)){
+            return k;
+        }
+
+        const T beta = (rho_new / rho) * (alpha / omega);
+        rho = rho_new;
+        krylov_sweep(n_row, bicgstab_direction<I,T>(beta, omega, r.data(), v.data(), p.data(), D, Ph), 0, sums);
+
+        krylov_sweep(n_row, krylov_matvec<I,T>(Ap, Aj, Ax, Ph, v.data(), rhat.data()), 1, sums);
+        const T rv = sums[0];
+        if(rv == T(0)){
+            return k;
+        }
+        alpha = rho / rv;
+
+        krylov_sweep(n_row, bicgstab_half_step<I,T>(alpha, v.data(), r.data(), D, Sh), 1, sums);
+        const double snorm = std::sqrt(real_part(sums[0]));
+        if(snorm <= threshold){
+            krylov_sweep(n_row, krylov_axpy<I,T>(alpha, Ph, Xx), 0, sums);
+            resvec[k+1] = snorm;
+            return k + 1;
+        }
+
+        // sums[0] = <s,t>, sums[1] = <t,t>
+        krylov_sweep(n_row, krylov_matvec<I,T,true>(Ap, Aj, Ax, Sh, t.data(), r.data()), 2, sums);
+        if(sums[1] == T(0)){
+            krylov_sweep(n_row, krylov_axpy<I,T>(alpha, Ph, Xx), 0, sums);
+            resvec[k+1] = snorm;
+            return k + 1;
+        }
+        omega = conjugate(sums[0]) / sums[1];
+
+        krylov_sweep(n_row, bicgstab_update<I,T>(alpha, omega, Ph, Sh, t.data(), rhat.data(), Xx, r.data()), 2, sums);
+        resvec[k+1] = std::sqrt(real_part(sums[0]));
+        rho_new = sums[1];
+        if(omega == T(0)){
+            return k + 1;
+        }
+    }
+    return maxiter;
+}
+
+
+/*
+ * Solve A*x = b with restarted GMRES(restart) for general A
+ *
+ *
+ * Input Arguments:
+ *   I  n_row         - number of rows (and columns) in A
+ *   I  Ap[n_row+1]   - row pointer
+ *   I  Aj[nnz(A)]    - column indices
+ *   T  Ax[nnz(A)]    - nonzeros
+ *   T  Bx[n_row]     - right-hand side
+ *   T  tol           - relative tolerance (real part)
+ *   I  restart       - Krylov subspace dimension between restarts
+ *   I  maxiter       - maximum number of (inner) iterations
+ *   I  jacobi        - nonzero to precondition with diag(A)
+ *
+ * Input/Output Arguments:
+ *   T  Xx[n_row]     - initial guess on entry, solution on exit
+ *
+ * Output Arguments:
+ *   T  resvec[maxiter+1] - residual norms ||b - A*x_k||, k = 0..iters
+ *
+ * Returns:
+ *   the number of iterations, iters.  The solve converged if
+ *   resvec[iters] <= tol*||b||.
+ *
+ * Note:
+ *   Preconditioning is from the right.  Within a cycle the residual
+ *   norms are the least squares estimates; at each restart the true
+ *   residual is computed and replaces the estimate for that iteration.
+ *
+ *   The Arnoldi basis is orthogonalized with classical Gram-Schmidt
+ *   and one reorthogonalization (CGS2): all inner products with the
+ *   basis are computed in a single pass, and each subtraction is fused
+ *   with the inner products that follow it.  Five passes per
+ *   iteration; the basis takes (restart+1)*n_row entries.
+ *
+ */
+template <class I, class T>
+I csr_gmres(const I n_row,
+            const I Ap[],
+            const I Aj[],
+            const T Ax[],
+            const T Bx[],
+                  T Xx[],
+            const T tol,
+            const I restart,
+            const I maxiter,
+            const I jacobi,
+                  T resvec[])
+{
+    std::vector<T> Dx;
+    if(jacobi){
+        krylov_jacobi(n_row, Ap, Aj, Ax, Dx);
+    }
+    const T * D = jacobi ? Dx.data() : 0;
+
+    const int m = (int)std::max((I)1, std::min(restart, std::max(n_row, (I)1)));
+    const npy_intp stride = n_row;
+    std::vector<T> V(stride * (m + 1)), z(jacobi ? n_row : 0);
+    std::vector<T> H((npy_intp)(m + 1) * m), cs(m), sn(m), g(m + 1), h(m + 1), h2(m + 1);
+
+    T sums[3];
+    double threshold = -1;
+    I iters = 0;
+
+    while(true){
+        // true residual at the start of every cycle
+        T * v0 = V.data();
+        krylov_sweep(n_row, krylov_residual<I,T>(Ap, Aj, Ax, Bx, Xx, v0), 3, sums);
+        const double beta = std::sqrt(real_part(sums[0]));
+        if(threshold < 0){
+            const double bnorm = std::sqrt(real_part(sums[1]));
+            if(bnorm == 0){
+                std::fill(Xx, Xx + n_row, T(0));
+                resvec[0] = 0;
+                return 0;
+            }
+            threshold = real_part(tol) * bnorm;
+        }
+        resvec[iters] = beta;
+        if(beta <= threshold || iters >= maxiter){
+            return iters;
+        }
+
+        krylov_sweep(n_row, gmres_normalize<I,T>(T(1) / T(beta), v0, D, jacobi ? z.data() : (T*)0), 0, sums);
+        std::fill(g.begin(), g.end(), T(0));
+        g[0] = beta;
+
+        int k = 0;
+        while(k < m && iters < maxiter){
+            T * w = &V[stride * (k + 1)];
+            const T * x = jacobi ? z.data() : &V[stride * k];
+            krylov_sweep(n_row, krylov_matvec<I,T>(Ap, Aj, Ax, x, w), 0, sums);
+
+            krylov_sweep(n_row, gmres_project<I,T>(V.data(), stride, k + 1, w), k + 1, h.data());
+            krylov_sweep(n_row, gmres_orthogonalize<I,T>(V.data(), stride, k + 1, h.data(), w, false), k + 1, h2.data());
+            krylov_sweep(n_row, gmres_orthogonalize<I,T>(V.data(), stride, k + 1, h2.data(), w, true), 1, sums);
+
+            T * Hk = &H[(npy_intp)k * (m + 1)];   // column k
+            for(int j = 0; j <= k; j++){
+                Hk[j] = h[j] + h2[j];
+            }
+            const double hnext = std::sqrt(real_part(sums[0]));
+            Hk[k+1] = hnext;
+
+            // apply the previous rotations, then the one that zeroes Hk[k+1]
+            for(int j = 0; j < k; j++){
+                const T a = Hk[j], b = Hk[j+1];
+                Hk[j]   = cs[j] * a + sn[j] * b;
+                Hk[j+1] = cs[j] * b - conjugate(sn[j]) * a;
+            }
+            const double abs_a = krylov_abs(Hk[k]);
+            const double nrm = std::sqrt(abs_a * abs_a + hnext * hnext);
+            if(nrm == 0){
+                cs[k] = 1;
+                sn[k] = 0;
+            } else if(abs_a == 0){
+                cs[k] = 0;
+                sn[k] = 1;
+                Hk[k] = hnext;
+            } else {
+                const T phase = Hk[k] / T(abs_a);
+                cs[k] = abs_a / nrm;
+                sn[k] = phase * T(hnext / nrm);
+                Hk[k] = phase * T(nrm);
+            }
+            Hk[k+1] = 0;
+            g[k+1] = -conjugate(sn[k]) * g[k];
+            g[k] = cs[k] * g[k];
+
+            k++;
+            iters++;
+            resvec[iters] = krylov_abs(g[k]);
+
+            if(hnext == 0 || real_part(resvec[iters]) <= threshold){
+                break;
+            }
+            krylov_sweep(n_row, gmres_normalize<I,T>(T(1) / T(hnext), w, D, jacobi ? z.data() : (T*)0), 0, sums);
+        }
+
+        // y = H[0:k,0:k] \ g[0:k], then x += D*V*y
+        for(int i = k - 1; i >= 0; i--){
+            T sum = g[i];
+            for(int j = i + 1; j < k; j++){
+                sum = sum - H[(npy_intp)j * (m + 1) + i] * h[j];
+            }
+            const T Hii = H[(npy_intp)i * (m + 1) + i];
+            h[i] = (Hii == T(0)) ? T(0) : T(sum / Hii);
+        }
+        krylov_sweep(n_row, gmres_update<I,T>(V.data(), stride, k, h.data(), D, Xx), 0, sums);
+    }
+}
+
+#endif
@@ -0,0 +1,412 @@
+#ifndef __KRYLOV_OPS_H__
+#define __KRYLOV_OPS_H__
+
+/*
+ * The passes of the Krylov solvers in krylov.h: krylov_sweep, which
+ * runs a pass over row blocks and sums its inner products in thread
+ * order, and one functor per fused pass.
+ *
+ * They are kept apart from krylov.h because generate_functions.py
+ * wraps every template of that header, and a functor parameter cannot
+ * be wrapped.
+ */
+
+#include <cmath>
+#include <vector>
+#include <algorithm>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "example_scipy_csr.h"
+#include "numa_ops.h"
+
+
+/*
+ * Run op over the n rows split into one schedule(static) block per
+ * thread and add up the n_sums partial sums it accumulates for each
+ * block into sums[], in thread order
+ *
+ * op(i0, i1, local) processes rows [i0, i1) and adds to local[0..n_sums),
+ * which starts out zero.
+ */
+template <class I, class T, class Op>
+void krylov_sweep(const I n, const Op& op, const int n_sums, T sums[])
+{
+    int n_threads = 1;
+#ifdef _OPENMP
+    if(n > parallel_threshold){
+        n_threads = omp_get_max_threads();
+    }
+#endif
+    std::vector<T> partial((npy_intp)n_threads * n_sums, T(0));
+
+    // the team may be smaller than asked for, so the rows are split by
+    // the threads that actually run
+    int n_team = 1;
+    #pragma omp parallel num_threads(n_threads)
+    {
+        int t = 0, team = 1;
+#ifdef _OPENMP
+        t = omp_get_thread_num();
+        team = omp_get_num_threads();
+#endif
+        if(t == 0){
+            n_team = team;
+        }
+        I i0, i1;
+        static_block(n, team, t, &i0, &i1);
+        op(i0, i1, partial.data() + (npy_intp)t * n_sums);
+    }
+
+    for(int k = 0; k < n_sums; k++){
+        T sum = 0;
+        for(int t = 0; t < n_team; t++){
+            sum += partial[(npy_intp)t * n_sums + k];
+        }
+        sums[k] = sum;
+    }
+}
+
+template <class T>
+inline double krylov_abs(const T& x){
+    return std::sqrt(real_part(conjugate(x) * x));
+}
+
+
+/*
+ * Y = A*X, with sums[0] = <W,Y> if W is given and sums[1] = <Y,Y>
+ * if yy is set; yy is a template argument so that the sweeps with one
+ * sum never index sums[1]
+ */
+template <class I, class T, bool yy = false>
+struct krylov_matvec {
+    const I * Ap; const I * Aj; const T * Ax;
+    const T * Xx; T * Yx; const T * Wx;
+
+    krylov_matvec(const I * Ap_, const I * Aj_, const T * Ax_, const T * Xx_, T * Yx_,
+                  const T * Wx_ = 0)
+        : Ap(Ap_), Aj(Aj_), Ax(Ax_), Xx(Xx_), Yx(Yx_), Wx(Wx_) {}
+
+    void operator()(const I i0, const I i1, T local[]) const {
+        T wy = 0, yy2 = 0;
+        for(I i = i0; i < i1; i++){
+            T sum = 0;
+            for(I jj = Ap[i]; jj < Ap[i+1]; jj++){
+                sum += Ax[jj] * Xx[Aj[jj]];
+            }
+            Yx[i] = sum;
+            if(Wx){ wy += conjugate(Wx[i]) * sum; }
+            if(yy){ yy2 += conjugate(sum) * sum; }
+        }
+        if(Wx){ local[0] += wy; }
+        if(yy){ local[1] += yy2; }
+    }
+};
+
+/*
+ * R = B - A*X and R2 = D*R (R2 = R without D) when R2 is given, with
+ * sums <R,R>, <B,B> and <R,D*R>
+ */
+template <class I, class T>
+struct krylov_residual {
+    const I * Ap; const I * Aj; const T * Ax;
+    const T * Bx; const T * Xx; T * Rx; T * R2x; const T * Dx;
+
+    krylov_residual(const I * Ap_, const I * Aj_, const T * Ax_, const T * Bx_,
+                    const T * Xx_, T * Rx_, T * R2x_ = 0, const T * Dx_ = 0)
+        : Ap(Ap_), Aj(Aj_), Ax(Ax_), Bx(Bx_), Xx(Xx_), Rx(Rx_), R2x(R2x_), Dx(Dx_) {}
+
+    void operator()(const I i0, const I i1, T local[]) const {
+        T rr = 0, bb = 0, rz = 0;
+        for(I i = i0; i < i1; i++){
+            T sum = Bx[i];
+            for(I jj = Ap[i]; jj < Ap[i+1]; jj++){
+                sum = sum - Ax[jj] * Xx[Aj[jj]];
+            }
+            Rx[i] = sum;
+            const T z = Dx ? T(Dx[i] * sum) : sum;
+            if(R2x){ R2x[i] = z; }
+            rr += conjugate(sum) * sum;
+            rz += conjugate(sum) * z;
+            bb += conjugate(Bx[i]) * Bx[i];
+        }
+        local[0] += rr;
+        local[1] += bb;
+        local[2] += rz;
+    }
+};
+
+
+/*
+ * Inverse diagonal of A for the Jacobi preconditioner: 1/A[i,i], or 1
+ * where the diagonal is zero
+ */
+template <class I, class T>
+void krylov_jacobi(const I n_row, const I Ap[], const I Aj[], const T Ax[], std::vector<T>& Dx)
+{
+    Dx.resize(n_row);
+    csr_diagonal(n_row, n_row, Ap, Aj, Ax, Dx.data());
+    #pragma omp parallel for schedule(static) if(n_row > parallel_threshold)
+    for(I i = 0; i < n_row; i++){
+        Dx[i] = (Dx[i] == T(0)) ? T(1) : T(T(1) / Dx[i]);
+    }
+}
+
+
+/*
+ * CG pass after q = A*p:  x += alpha*p, r -= alpha*q, z = D*r,
+ * with sums <r,r> and <r,z>
+ */
+template <class I, class T>
+struct cg_update {
+    T alpha; const T * Px; const T * Qx; T * Xx; T * Rx; const T * Dx; T * Zx;
+
+    cg_update(const T alpha_, const T * Px_, const T * Qx_, T * Xx_, T * Rx_, const T * Dx_, T * Zx_)
+        : alpha(alpha_), Px(Px_), Qx(Qx_), Xx(Xx_), Rx(Rx_), Dx(Dx_), Zx(Zx_) {}
+
+    void operator()(const I i0, const I i1, T local[]) const {
+        T rr = 0, rz = 0;
+        for(I i = i0; i < i1; i++){
+            Xx[i] += alpha * Px[i];
+            const T r = Rx[i] - alpha * Qx[i];
+            Rx[i] = r;
+            rr += conjugate(r) * r;
+            if(Dx){
+                const T z = Dx[i] * r;
+                Zx[i] = z;
+                rz += conjugate(r) * z;
+            }
+        }
+        local[0] += rr;
+        local[1] += Dx ? rz : rr;
+    }
+};
+
+/*
+ * p = z + beta*p
+ */
+template <class I, class T>
+struct cg_direction {
+    T beta; const T * Zx; T * Px;
+
+    cg_direction(const T beta_, const T * Zx_, T * Px_) : beta(beta_), Zx(Zx_), Px(Px_) {}
+
+    void operator()(const I i0, const I i1, T local[]) const {
+        for(I i = i0; i < i1; i++){
+            Px[i] = Zx[i] + beta * Px[i];
+        }
+    }
+};
+
+
+/*
+ * BiCGStab pass:  p = r + beta*(p - omega*v), phat = D*p
+ */
+template <class I, class T>
+struct bicgstab_direction {
+    T beta; T omega; const T * Rx; const T * Vx; T * Px; const T * Dx; T * Phx;
+
+    bicgstab_direction(const T beta_, const T omega_, const T * Rx_, const T * Vx_, T * Px_,
+                       const T * Dx_, T * Phx_)
+        : beta(beta_), omega(omega_), Rx(Rx_), Vx(Vx_), Px(Px_), Dx(Dx_), Phx(Phx_) {}
+
+    void operator()(const I i0, const I i1, T local[]) const {
+        for(I i = i0; i < i1; i++){
+            const T p = Rx[i] + beta * (Px[i] - omega * Vx[i]);
+            Px[i] = p;
+            if(Dx){ Phx[i] = Dx[i] * p; }
+        }
+    }
+};
+
+/*
+ * BiCGStab pass:  s = r - alpha*v (in place in r), shat = D*s,
+ * with sum <s,s>
+ */
+template <class I, class T>
+struct bicgstab_half_step {
+    T alpha; const T * Vx; T * Rx; const T * Dx; T * Shx;
+
+    bicgstab_half_step(const T alpha_, const T * Vx_, T * Rx_, const T * Dx_, T * Shx_)
+        : alpha(alpha_), Vx(Vx_), Rx(Rx_), Dx(Dx_), Shx(Shx_) {}
+
+    void operator()(const I i0, const I i1, T local[]) const {
+        T ss = 0;
+        for(I i = i0; i < i1; i++){
+            const T s = Rx[i] - alpha * Vx[i];
+            Rx[i] = s;
+            if(Dx){ Shx[i] = Dx[i] * s; }
+            ss += conjugate(s) * s;
+        }
+        local[0] += ss;
+    }
+};
+
+/*
+ * BiCGStab pass:  x += alpha*phat + omega*shat, r = s - omega*t,
+ * with sums <r,r> and <rhat,r>
+ */
+template <class I, class T>
+struct bicgstab_update {
+    T alpha; T omega; const T * Phx; const T * Shx; const T * Tx; const T * Rhx; T * Xx; T * Rx;
+
+    bicgstab_update(const T alpha_, const T omega_, const T * Phx_, const T * Shx_,
+                    const T * Tx_, const T * Rhx_, T * Xx_, T * Rx_)
+        : alpha(alpha_), omega(omega_), Phx(Phx_), Shx(Shx_), Tx(Tx_), Rhx(Rhx_), Xx(Xx_), Rx(Rx_) {}
+
+    void operator()(const I i0, const I i1, T local[]) const {
+        T rr = 0, rhr = 0;
+        for(I i = i0; i < i1; i++){
+            Xx[i] += alpha * Phx[i] + omega * Shx[i];
+            const T r = Rx[i] - omega * Tx[i];
+            Rx[i] = r;
+            rr += conjugate(r) * r;
+            rhr += conjugate(Rhx[i]) * r;
+        }
+        local[0] += rr;
+        local[1] += rhr;
+    }
+};
+
+/*
+ * x += alpha*phat
+ */
+template <class I, class T>
+struct krylov_axpy {
+    T alpha; const T * Px; T * Xx;
+
+    krylov_axpy(const T alpha_, const T * Px_, T * Xx_) : alpha(alpha_), Px(Px_), Xx(Xx_) {}
+
+    void operator()(const I i0, const I i1, T local[]) const {
+        for(I i = i0; i < i1; i++){
+            Xx[i] += alpha * Px[i];
+        }
+    }
+};
+
+
+/*
+ * The GMRES passes run over the basis vectors for one block of
+ * gmres_block rows at a time, so the block of w (or x) stays in cache
+ * while every basis vector streams past it once.
+ */
+const int gmres_block = 256;
+
+/*
+ * GMRES pass:  h[j] = <V_j,w> for j < n_basis (classical Gram-Schmidt)
+ */
+template <class I, class T>
+struct gmres_project {
+    const T * Vx; npy_intp stride; int n_basis; const T * Wx;
+
+    gmres_project(const T * Vx_, const npy_intp stride_, const int n_basis_, const T * Wx_)
+        : Vx(Vx_), stride(stride_), n_basis(n_basis_), Wx(Wx_) {}
+
+    void operator()(const I i0, const I i1, T local[]) const {
+        for(I b0 = i0; b0 < i1; b0 += gmres_block){
+            const I b1 = std::min(i1, (I)(b0 + gmres_block));
+            for(int j = 0; j < n_basis; j++){
+                const T * v = Vx + stride * j;
+                T sum = 0;
+                for(I i = b0; i < b1; i++){
+                    sum += conjugate(v[i]) * Wx[i];
+                }
+                local[j] += sum;
+            }
+        }
+    }
+};
+
+/*
+ * GMRES pass:  w -= sum_j h[j]*V_j, then either h2[j] = <V_j,w>
+ * (reorthogonalization) or, with norm set, <w,w> in local[0]
+ */
+template <class I, class T>
+struct gmres_orthogonalize {
+    const T * Vx; npy_intp stride; int n_basis; const T * h; T * Wx; bool norm;
+
+    gmres_orthogonalize(const T * Vx_, const npy_intp stride_, const int n_basis_,
+                        const T * h_, T * Wx_, const bool norm_)
+        : Vx(Vx_), stride(stride_), n_basis(n_basis_), h(h_), Wx(Wx_), norm(norm_) {}
+
+    void operator()(const I i0, const I i1, T local[]) const {
+        for(I b0 = i0; b0 < i1; b0 += gmres_block){
+            const I b1 = std::min(i1, (I)(b0 + gmres_block));
+            for(int j = 0; j < n_basis; j++){
+                const T * v = Vx + stride * j;
+                const T hj = h[j];
+                for(I i = b0; i < b1; i++){
+                    Wx[i] = Wx[i] - hj * v[i];
+                }
+            }
+            if(norm){
+                T ww = 0;
+                for(I i = b0; i < b1; i++){
+                    ww += conjugate(Wx[i]) * Wx[i];
+                }
+                local[0] += ww;
+            } else {
+                for(int j = 0; j < n_basis; j++){
+                    const T * v = Vx + stride * j;
+                    T sum = 0;
+                    for(I i = b0; i < b1; i++){
+                        sum += conjugate(v[i]) * Wx[i];
+                    }
+                    local[j] += sum;
+                }
+            }
+        }
+    }
+};
+
+/*
+ * GMRES pass:  v *= s, z = D*v
+ */
+template <class I, class T>
+struct gmres_normalize {
+    T s; T * Vx; const T * Dx; T * Zx;
+
+    gmres_normalize(const T s_, T * Vx_, const T * Dx_, T * Zx_) : s(s_), Vx(Vx_), Dx(Dx_), Zx(Zx_) {}
+
+    void operator()(const I i0, const I i1, T local[]) const {
+        for(I i = i0; i < i1; i++){
+            const T v = Vx[i] * s;
+            Vx[i] = v;
+            if(Dx){ Zx[i] = Dx[i] * v; }
+        }
+    }
+};
+
+/*
+ * GMRES pass:  x += D * sum_j y[j]*V_j
+ */
+template <class I, class T>
+struct gmres_update {
+    const T * Vx; npy_intp stride; int n_basis; const T * y; const T * Dx; T * Xx;
+
+    gmres_update(const T * Vx_, const npy_intp stride_, const int n_basis_, const T * y_,
+                 const T * Dx_, T * Xx_)
+        : Vx(Vx_), stride(stride_), n_basis(n_basis_), y(y_), Dx(Dx_), Xx(Xx_) {}
+
+    void operator()(const I i0, const I i1, T local[]) const {
+        T sum[gmres_block];
+        for(I b0 = i0; b0 < i1; b0 += gmres_block){
+            const I len = std::min(i1 - b0, (I)gmres_block);
+            std::fill(sum, sum + len, T(0));
+            for(int j = 0; j < n_basis; j++){
+                const T * v = Vx + stride * j + b0;
+                const T yj = y[j];
+                for(I i = 0; i < len; i++){
+                    sum[i] += yj * v[i];
+                }
+            }
+            for(I i = 0; i < len; i++){
+                Xx[b0 + i] += Dx ? T(Dx[b0 + i] * sum[i]) : sum[i];
+            }
+        }
+    }
+};
+
+#endif
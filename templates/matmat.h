@@ -0,0 +1,177 @@
+#ifndef __MATMAT_H__
+#define __MATMAT_H__
+
+/*
+ * Sparse matrix-matrix product C = A*B of CSR matrices, in two passes:
+ * csr_matmat_pass1 fills the row pointer of C, the caller allocates Cj
+ * and Cx of size Cp[n_row], and csr_matmat_pass2 fills them.
+ */
+
+#include <vector>
+#include <stdexcept>
+
+#include "util.h"
+
+
+/*
+ * Compute C = A*B for CSR matrices A,B
+ *
+ *
+ * Input Arguments:
+ *   I  n_row       - number of rows in A
+ *   I  n_col       - number of columns in B (hence C is n_row by n_col)
+ *   P  Ap[n_row+1] - row pointer
+ *   I  Aj[nnz(A)]  - column indices
+ *   T  Ax[nnz(A)]  - nonzeros
+ *   P  Bp[?]       - row pointer
+ *   I  Bj[nnz(B)]  - column indices
+ *   T  Bx[nnz(B)]  - nonzeros
+ * Output Arguments:
+ *   P  Cp[n_row+1] - row pointer
+ *   I  Cj[nnz(C)]  - column indices
+ *   T  Cx[nnz(C)]  - nonzeros
+ *   
+ * Note:
+ *   Output arrays Cp, Cj, and Cx must be preallocated
+ *   The value of nnz(C) will be stored in Ap[n_row] after the first pass.
+ *
+ * Note: 
+ *   Input:  A and B column indices *are not* assumed to be in sorted order 
+ *   Output: C column indices *are not* assumed to be in sorted order
+ *           Cx will not contain any zero entries
+ *
+ *   Complexity: O(n_row*K^2 + max(n_row,n_col)) 
+ *                 where K is the maximum nnz in a row of A
+ *                 and column of B.
+ *
+ *   The row pointers (type P) may be wider than the column indices
+ *   (type I), so a product with nnz(C) >= 2^31 only needs a 64-bit Cp.
+ *
+ *
+ *  This is an implementation of the SMMP algorithm:
+ *
+ *    "Sparse Matrix Multiplication Package (SMMP)"
+ *      Randolph E. Bank and Craig C. Douglas
+ *
+ *    http://citeseer.ist.psu.edu/445062.html
+ *    http://www.mgnet.org/~douglas/ccd-codes.html
+ *
+ */
+
+
+/*
+ * Pass 1 computes CSR row pointer for the matrix product C = A * B
+ *
+ */
+template <class I, class P>
+void csr_matmat_pass1(const I n_row,
+                      const I n_col, 
+                      const P Ap[], 
+                      const I Aj[], 
+                      const P Bp[],
+                      const I Bj[],
+                            P Cp[])
+{
+    // method that uses O(n) temp storage
+    std::vector<I> mask(n_col, -1);
+    Cp[0] = 0;
+
+    P nnz = 0;
+    for(I i = 0; i < n_row; i++){
+        npy_intp row_nnz = 0;
+
+        for(P jj = Ap[i]; jj < Ap[i+1]; jj++){
+            I j = Aj[jj];
+            for(P kk = Bp[j]; kk < Bp[j+1]; kk++){
+                I k = Bj[kk];
+                if(mask[k] != i){
+                    mask[k] = i;                        
+                    row_nnz++;
+                }
+            }
+        }
+
+        npy_intp next_nnz = nnz + row_nnz;
+
+        if (row_nnz > NPY_MAX_INTP - nnz || next_nnz != (P)next_nnz) {
+            /*
+             * Index overflowed. Note that row_nnz <= n_col and cannot overflow
+             */
+            throw std::overflow_error("nnz of the result is too large");
+        }
+
+        nnz = next_nnz;
+        Cp[i+1] = nnz;
+    }
+}
+
+/*
+ * Pass 2 computes CSR entries for matrix C = A*B using the 
+ * row pointer Cp[] computed in Pass 1.
+ *
+ */
+template <class I, class T, class P>
+void csr_matmat_pass2(const I n_row,
+      	              const I n_col, 
+      	              const P Ap[], 
+      	              const I Aj[], 
+      	              const T Ax[],
+      	              const P Bp[],
+      	              const I Bj[],
+      	              const T Bx[],
+      	                    P Cp[],
+      	                    I Cj[],
+      	                    T Cx[])
+{
+    std::vector<I> next(n_col,-1);
+    std::vector<T> sums(n_col, 0);
+
+    P nnz = 0;
+
+    Cp[0] = 0;
+
+    for(I i = 0; i < n_row; i++){
+        I head   = -2;
+        I length =  0;
+
+        P jj_start = Ap[i];
+        P jj_end   = Ap[i+1];
+        for(P jj = jj_start; jj < jj_end; jj++){
+            I j = Aj[jj];
+            T v = Ax[jj];
+
+            P kk_start = Bp[j];
+            P kk_end   = Bp[j+1];
+            for(P kk = kk_start; kk < kk_end; kk++){
+                I k = Bj[kk];
+
+                sums[k] += v*Bx[kk];
+
+                if(next[k] == -1){
+                    next[k] = head;                        
+                    head  = k;
+                    length++;
+                }
+            }
+        }         
+
+        for(I jj = 0; jj < length; jj++){
+
+            if(sums[head] != 0){
+                Cj[nnz] = head;
+                Cx[nnz] = sums[head];
+                nnz++;
+            }
+
+            I temp = head;                
+            head = next[head];
+
+            next[temp] = -1; //clear arrays
+            sums[temp] =  0;                              
+        }
+
+        Cp[i+1] = nnz;
+    }
+}
+
+#endif
@@ -0,0 +1,641 @@
+#ifndef __MATVEC_H__
+#define __MATVEC_H__
+
+/*
+ * Products of CSR matrices with dense vectors and blocks of vectors.
+ *
+ * csr_matvec and csr_matvecs are the serial loops of scipy's
+ * sparsetools, with a row pointer type P that may be wider than I.
+ * Rows of Y are independent, so the other products are parallel over
+ * rows with schedule(static), which keeps each thread on the same
+ * block of rows from one call to the next (see numa.h);
+ * csr_matvecs_colmajor splits the rows into panels instead, and
+ * csr_matvec_batched goes over the matrices of the batch.
+ */
+
+#include <vector>
+#include <algorithm>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "util.h"
+#include "dense.h"
+#include "matvec_ops.h"
+#include "csr_symv.h"
+
+
+/*
+ * Compute Y += A*X for CSR matrix A and dense vectors X,Y
+ *
+ *
+ * Input Arguments:
+ *   I  n_row         - number of rows in A
+ *   I  n_col         - number of columns in A
+ *   P  Ap[n_row+1]   - row pointer
+ *   I  Aj[nnz(A)]    - column indices
+ *   T  Ax[nnz(A)]    - nonzeros
+ *   T  Xx[n_col]     - input vector
+ *
+ * Output Arguments:
+ *   T  Yx[n_row]     - output vector
+ *
+ * Note:
+ *   Output array Yx must be preallocated
+ *
+ *   Complexity: Linear.  Specifically O(nnz(A) + n_row)
+ *
+ *   Ap may use a wider type P than Aj, see csr_tocsc.
+ * 
+ */
+template <class I, class T, class P>
+void csr_matvec(const I n_row,
+	            const I n_col, 
+	            const P Ap[], 
+	            const I Aj[], 
+	            const T Ax[],
+	            const T Xx[],
+	                  T Yx[])
+{
+    for(I i = 0; i < n_row; i++){
+        T sum = Yx[i];
+        for(P jj = Ap[i]; jj < Ap[i+1]; jj++){
+            sum += Ax[jj] * Xx[Aj[jj]];
+        }
+        Yx[i] = sum;
+    }
+}
+
+
+/*
+ * Compute Y += A*X for CSR matrix A and dense block vectors X,Y
+ *
+ *
+ * Input Arguments:
+ *   I  n_row            - number of rows in A
+ *   I  n_col            - number of columns in A
+ *   I  n_vecs           - number of column vectors in X and Y
+ *   P  Ap[n_row+1]      - row pointer
+ *   I  Aj[nnz(A)]       - column indices
+ *   T  Ax[nnz(A)]       - nonzeros
+ *   T  Xx[n_col,n_vecs] - input vector
+ *
+ * Output Arguments:
+ *   T  Yx[n_row,n_vecs] - output vector
+ *
+ */
+template <class I, class T, class P>
+void csr_matvecs(const I n_row,
+	             const I n_col, 
+                 const I n_vecs,
+	             const P Ap[], 
+	             const I Aj[], 
+	             const T Ax[],
+	             const T Xx[],
+	                   T Yx[])
+{
+    for(I i = 0; i < n_row; i++){
+        T * y = Yx + (npy_intp)n_vecs * i;
+        for(P jj = Ap[i]; jj < Ap[i+1]; jj++){
+            const I j = Aj[jj];
+            const T a = Ax[jj];
+            const T * x = Xx + (npy_intp)n_vecs * j;
+            axpy(n_vecs, a, x, y);
+        }
+    }
+}
+
+
+/*
+ * Compute Y += A*X for CSR matrix A and dense block vectors X,Y
+ * stored column-major (Fortran order)
+ *
+ *
+ * Input Arguments:
+ *   I  n_row            - number of rows in A
+ *   I  n_col            - number of columns in A
+ *   I  n_vecs           - number of column vectors in X and Y
+ *   P  Ap[n_row+1]      - row pointer
+ *   I  Aj[nnz(A)]       - column indices
+ *   T  Ax[nnz(A)]       - nonzeros
+ *   T  Xx[ldx*n_vecs]   - input vectors, X[j,v] = Xx[j + ldx*v]
+ *   I  ldx              - leading dimension of X, ldx >= n_col
+ *   I  ldy              - leading dimension of Y, ldy >= n_row
+ *
+ * Output Arguments:
+ *   T  Yx[ldy*n_vecs]   - output vectors, Y[i,v] = Yx[i + ldy*v]
+ *
+ * Note:
+ *   Each column X[:,v] and Y[:,v] is contiguous, as in LAPACK, so a
+ *   Fortran-ordered block (or a column slice of a larger one) is used
+ *   in place, without a transposed copy.
+ *
+ *   The rows are split into panels of about 16384 nonzeros, which
+ *   stay in cache while every vector is multiplied by them, so A is
+ *   read from memory once rather than n_vecs times.  Within a panel
+ *   the vectors go four at a time: each entry of A is loaded once for
+ *   four independent sums.  The (panel, group of four vectors) pairs
+ *   are processed in parallel, panel by panel, so a small A with many
+ *   vectors is split too, and each thread works on as few panels as
+ *   the split allows.
+ *
+ *   Complexity: Linear.  Specifically O(nnz(A)*n_vecs + n_row)
+ *
+ */
+template <class I, class T, class P>
+void csr_matvecs_colmajor(const I n_row,
+                          const I n_col,
+                          const I n_vecs,
+                          const P Ap[],
+                          const I Aj[],
+                          const T Ax[],
+                          const T Xx[],
+                          const I ldx,
+                                T Yx[],
+                          const I ldy)
+{
+    const P panel_nnz = 16384; // constant is arbitrary
+    const P nnz = Ap[n_row];
+    const npy_intp n_panels = nnz / panel_nnz + 1;
+    const npy_intp n_groups = ((npy_intp)n_vecs + 3) / 4;
+
+    #pragma omp parallel for schedule(static) if((npy_intp)nnz * n_vecs > parallel_threshold)
+    for(npy_intp w = 0; w < n_panels * n_groups; w++){
+        const npy_intp b = w / n_groups;
+        const I v0 = (I)(4 * (w % n_groups));
+        const I v1 = std::min<I>(v0 + 4, n_vecs);
+
+        // rows whose first entry is in [b*panel_nnz, (b+1)*panel_nnz)
+        const I i0 = (I)(std::lower_bound(Ap, Ap + n_row, (P)(b * panel_nnz)) - Ap);
+        const I i1 = (b + 1 == n_panels) ? n_row :
+                     (I)(std::lower_bound(Ap, Ap + n_row, (P)((b + 1) * panel_nnz)) - Ap);
+
+        if(v1 - v0 == 4){
+            const T * x0 = Xx + (npy_intp)ldx * v0;
+            const T * x1 = x0 + ldx;
+            const T * x2 = x1 + ldx;
+            const T * x3 = x2 + ldx;
+            T * y0 = Yx + (npy_intp)ldy * v0;
+            T * y1 = y0 + ldy;
+            T * y2 = y1 + ldy;
+            T * y3 = y2 + ldy;
+            for(I i = i0; i < i1; i++){
+                T sum0 = y0[i], sum1 = y1[i], sum2 = y2[i], sum3 = y3[i];
+                for(P jj = Ap[i]; jj < Ap[i+1]; jj++){
+                    const I j = Aj[jj];
+                    const T a = Ax[jj];
+                    sum0 += a * x0[j];
+                    sum1 += a * x1[j];
+                    sum2 += a * x2[j];
+                    sum3 += a * x3[j];
+                }
+                y0[i] = sum0;
+                y1[i] = sum1;
+                y2[i] = sum2;
+                y3[i] = sum3;
+            }
+        } else {
+            for(I v = v0; v < v1; v++){
+                const T * x = Xx + (npy_intp)ldx * v;
+                T * y = Yx + (npy_intp)ldy * v;
+                for(I i = i0; i < i1; i++){
+                    T sum = y[i];
+                    for(P jj = Ap[i]; jj < Ap[i+1]; jj++){
+                        sum += Ax[jj] * x[Aj[jj]];
+                    }
+                    y[i] = sum;
+                }
+            }
+        }
+    }
+}
+
+
+/*
+ * Compute Y[b] += A[b]*X[b] for a batch of CSR matrices A[b] that share
+ * one sparsity pattern
+ *
+ *
+ * Input Arguments:
+ *   I  n_batch                - number of matrices
+ *   I  n_row                  - number of rows in each A[b]
+ *   I  n_col                  - number of columns in each A[b]
+ *   P  Ap[n_row+1]            - row pointer, shared
+ *   I  Aj[nnz]                - column indices, shared
+ *   T  Ax[n_batch,nnz]        - nonzeros, row b is A[b]
+ *   T  Xx[n_batch,n_col]      - input vectors
+ *
+ * Output Arguments:
+ *   T  Yx[n_batch,n_row]      - output vectors
+ *
+ * Note:
+ *   All arrays are C-contiguous.  Y[b] is the same as from
+ *   csr_matvec(n_row, n_col, Ap, Aj, Ax + nnz*b, Xx + n_col*b,
+ *   Yx + n_row*b), to the last bit.
+ *
+ *   The batch goes four matrices at a time: each entry of the pattern
+ *   is loaded once for four independent sums, one per matrix, rather
+ *   than one sum whose additions wait on each other.  Groups of four
+ *   are processed in parallel.
+ *
+ *   Complexity: Linear.  Specifically O(n_batch*(nnz + n_row))
+ *
+ */
+template <class I, class T, class P>
+void csr_matvec_batched(const I n_batch,
+                        const I n_row,
+                        const I n_col,
+                        const P Ap[],
+                        const I Aj[],
+                        const T Ax[],
+                        const T Xx[],
+                              T Yx[])
+{
+    const P nnz = Ap[n_row];
+    const I n_groups = (n_batch + 3) / 4;
+
+    #pragma omp parallel for schedule(static) if((npy_intp)n_batch * nnz > parallel_threshold)
+    for(I g = 0; g < n_groups; g++){
+        I b = 4 * g;
+        if(b + 4 <= n_batch){
+            const T * a0 = Ax + (npy_intp)nnz * b;
+            const T * a1 = a0 + nnz;
+            const T * a2 = a1 + nnz;
+            const T * a3 = a2 + nnz;
+            const T * x0 = Xx + (npy_intp)n_col * b;
+            const T * x1 = x0 + n_col;
+            const T * x2 = x1 + n_col;
+            const T * x3 = x2 + n_col;
+            T * y0 = Yx + (npy_intp)n_row * b;
+            T * y1 = y0 + n_row;
+            T * y2 = y1 + n_row;
+            T * y3 = y2 + n_row;
+            for(I i = 0; i < n_row; i++){
+                T sum0 = y0[i], sum1 = y1[i], sum2 = y2[i], sum3 = y3[i];
+                for(P jj = Ap[i]; jj < Ap[i+1]; jj++){
+                    const I j = Aj[jj];
+                    sum0 += a0[jj] * x0[j];
+                    sum1 += a1[jj] * x1[j];
+                    sum2 += a2[jj] * x2[j];
+                    sum3 += a3[jj] * x3[j];
+                }
+                y0[i] = sum0;
+                y1[i] = sum1;
+                y2[i] = sum2;
+                y3[i] = sum3;
+            }
+        } else {
+            for(; b < n_batch; b++){
+                csr_matvec(n_row, n_col, Ap, Aj,
+                           Ax + (npy_intp)nnz * b,
+                           Xx + (npy_intp)n_col * b,
+                           Yx + (npy_intp)n_row * b);
+            }
+        }
+    }
+}
+
+
+/*
+ * Compute Y = alpha*A*X + beta*Y for CSR matrix A and dense vectors X,Y
+ *
+ *
+ * Input Arguments:
+ *   I  n_row         - number of rows in A
+ *   I  n_col         - number of columns in A
+ *   I  Ap[n_row+1]   - row pointer
+ *   I  Aj[nnz(A)]    - column indices
+ *   T  Ax[nnz(A)]    - nonzeros
+ *   T  alpha         - scale of A*X
+ *   T  Xx[n_col]     - input vector
+ *   T  beta          - scale of Y
+ *
+ * Output Arguments:
+ *   T  Yx[n_row]     - output vector
+ *
+ * Note:
+ *   Output array Yx must be preallocated
+ *
+ *   If beta == 0, Yx is write-only: it is never read, so it may
+ *   hold uninitialized values (even NaN) on entry.
+ *
+ *   Rows are independent and processed in parallel.
+ *
+ *   Complexity: Linear.  Specifically O(nnz(A) + n_row)
+ *
+ */
+template <class I, class T>
+void csr_matvec_alpha_beta(const I n_row,
+                           const I n_col,
+                           const I Ap[],
+                           const I Aj[],
+                           const T Ax[],
+                           const T alpha,
+                           const T Xx[],
+                           const T beta,
+                                 T Yx[])
+{
+    if(beta == 0){
+        #pragma omp parallel for schedule(static) if(Ap[n_row] > parallel_threshold)
+        for(I i = 0; i < n_row; i++){
+            T sum = 0;
+            for(I jj = Ap[i]; jj < Ap[i+1]; jj++){
+                sum += Ax[jj] * Xx[Aj[jj]];
+            }
+            Yx[i] = alpha * sum;
+        }
+    } else {
+        #pragma omp parallel for schedule(static) if(Ap[n_row] > parallel_threshold)
+        for(I i = 0; i < n_row; i++){
+            T sum = 0;
+            for(I jj = Ap[i]; jj < Ap[i+1]; jj++){
+                sum += Ax[jj] * Xx[Aj[jj]];
+            }
+            Yx[i] = alpha * sum + beta * Yx[i];
+        }
+    }
+}
+
+
+/*
+ * Compute Y = alpha*A*X + beta*Y for CSR matrix A and dense block
+ * vectors X,Y
+ *
+ *
+ * Input Arguments:
+ *   I  n_row            - number of rows in A
+ *   I  n_col            - number of columns in A
+ *   I  n_vecs           - number of column vectors in X and Y
+ *   I  Ap[n_row+1]      - row pointer
+ *   I  Aj[nnz(A)]       - column indices
+ *   T  Ax[nnz(A)]       - nonzeros
+ *   T  alpha            - scale of A*X
+ *   T  Xx[n_col,n_vecs] - input vector
+ *   T  beta             - scale of Y
+ *
+ * Output Arguments:
+ *   T  Yx[n_row,n_vecs] - output vector
+ *
+ * Note:
+ *   If beta == 0, Yx is write-only, as in csr_matvec_alpha_beta.
+ *   Each row of Y is scaled once and then accumulated into while
+ *   it is in cache, so Y is streamed through memory only once.
+ *
+ */
+template <class I, class T>
+void csr_matvecs_alpha_beta(const I n_row,
+                            const I n_col,
+                            const I n_vecs,
+                            const I Ap[],
+                            const I Aj[],
+                            const T Ax[],
+                            const T alpha,
+                            const T Xx[],
+                            const T beta,
+                                  T Yx[])
+{
+    #pragma omp parallel for schedule(static) if((npy_intp)Ap[n_row] * n_vecs > parallel_threshold)
+    for(I i = 0; i < n_row; i++){
+        T * y = Yx + (npy_intp)n_vecs * i;
+        if(beta == 0){
+            std::fill(y, y + n_vecs, T(0));
+        } else {
+            scal(n_vecs, beta, y);
+        }
+        for(I jj = Ap[i]; jj < Ap[i+1]; jj++){
+            const I j = Aj[jj];
+            const T a = alpha * Ax[jj];
+            const T * x = Xx + (npy_intp)n_vecs * j;
+            axpy(n_vecs, a, x, y);
+        }
+    }
+}
+
+
+/*
+ * Compute Y += A^T*X for CSR matrix A and dense vectors X,Y
+ *
+ *
+ * Input Arguments:
+ *   I  n_row         - number of rows in A
+ *   I  n_col         - number of columns in A
+ *   I  Ap[n_row+1]   - row pointer
+ *   I  Aj[nnz(A)]    - column indices
+ *   T  Ax[nnz(A)]    - nonzeros
+ *   T  Xx[n_row]     - input vector
+ *
+ * Output Arguments:
+ *   T  Yx[n_col]     - output vector
+ *
+ * Note:
+ *   Output array Yx must be preallocated
+ *
+ *   A^T is never formed: row i of A scatters Ax[jj]*X[i] into
+ *   Y[Aj[jj]].  In parallel the scattered writes of different rows
+ *   collide, so either
+ *     - each thread gets a private Y and the copies are reduced,
+ *       when n_threads*n_col <= nnz(A), or
+ *     - Y is updated atomically otherwise.
+ *   Small products run serially.
+ *
+ *   Complexity: Linear.  Specifically O(nnz(A) + n_row)
+ *
+ */
+template <class I, class T>
+void csr_matvec_transpose(const I n_row,
+                          const I n_col,
+                          const I Ap[],
+                          const I Aj[],
+                          const T Ax[],
+                          const T Xx[],
+                                T Yx[])
+{
+#ifdef _OPENMP
+    const npy_intp nnz = Ap[n_row];
+    const int n_threads = omp_get_max_threads();
+
+    if(n_threads > 1 && nnz > parallel_threshold){
+        if((npy_intp)n_threads * n_col <= nnz)
+            csr_matvec_transpose_private(n_row, n_col, Ap, Aj, Ax, Xx, Yx, n_threads);
+        else
+            csr_matvec_transpose_atomic(n_row, n_col, Ap, Aj, Ax, Xx, Yx, n_threads);
+        return;
+    }
+#endif
+
+    for(I i = 0; i < n_row; i++){
+        const T x = Xx[i];
+        for(I jj = Ap[i]; jj < Ap[i+1]; jj++){
+            Yx[Aj[jj]] += Ax[jj] * x;
+        }
+    }
+}
+
+
+/*
+ * Compute Y += A*X for a symmetric (or Hermitian) CSR matrix A
+ * stored as one triangle
+ *
+ *
+ * Input Arguments:
+ *   I  n_row         - number of rows (and columns) in A
+ *   I  Ap[n_row+1]   - row pointer
+ *   I  Aj[nnz(A)]    - column indices
+ *   T  Ax[nnz(A)]    - nonzeros
+ *   I  hermitian     - nonzero if A is Hermitian rather than symmetric
+ *   T  Xx[n_row]     - input vector
+ *
+ * Output Arguments:
+ *   T  Yx[n_row]     - output vector
+ *
+ * Note:
+ *   Output array Yx must be preallocated
+ *
+ *   Either the upper or the lower triangle (with the diagonal) may
+ *   be stored; each off-diagonal entry A(i,j) is applied both to
+ *   Y[i] and, as A(j,i) = A(i,j) (or conj(A(i,j))), to Y[j].
+ *   A must not store both A(i,j) and A(j,i).
+ *
+ *   For real types hermitian has no effect.
+ *
+ *   Complexity: Linear.  Specifically O(nnz(A) + n_row)
+ *
+ */
+template <class I, class T>
+void csr_symv(const I n_row,
+              const I Ap[],
+              const I Aj[],
+              const T Ax[],
+              const I hermitian,
+              const T Xx[],
+                    T Yx[])
+{
+#ifdef _OPENMP
+    const npy_intp nnz = Ap[n_row];
+    const int n_threads = omp_get_max_threads();
+
+    if(n_threads > 1 && nnz > parallel_threshold){
+        if(hermitian)
+            csr_symv_blocked<true>(n_row, Ap, Aj, Ax, Xx, Yx, n_threads);
+        else
+            csr_symv_blocked<false>(n_row, Ap, Aj, Ax, Xx, Yx, n_threads);
+        return;
+    }
+#endif
+
+    if(hermitian)
+        csr_symv_rows<true>((I)0, n_row, Ap, Aj, Ax, Xx, Yx, (T*)0, (I)0);
+    else
+        csr_symv_rows<false>((I)0, n_row, Ap, Aj, Ax, Xx, Yx, (T*)0, (I)0);
+}
+
+
+/*
+ * Compute Y += A*X for CSR matrix A stored in a narrower type than X,Y
+ *
+ *
+ * Input Arguments:
+ *   I  n_row         - number of rows in A
+ *   I  n_col         - number of columns in A
+ *   I  Ap[n_row+1]   - row pointer
+ *   I  Aj[nnz(A)]    - column indices
+ *   S  Ax[nnz(A)]    - nonzeros, in the storage type
+ *   T  Xx[n_col]     - input vector
+ *
+ * Output Arguments:
+ *   T  Yx[n_row]     - output vector
+ *
+ * Note:
+ *   Output array Yx must be preallocated
+ *
+ *   S is one of the ST_TYPES storage types of generate_functions.py and
+ *   is never wider than T, e.g. float32 Ax with float64 X and Y.  Each
+ *   value is widened as it is loaded, so A is streamed at its storage
+ *   width.  Sums are carried in mixed_accumulator<T>, i.e. in double
+ *   precision even when T is single precision.
+ *
+ *   Complexity: Linear.  Specifically O(nnz(A) + n_row)
+ *
+ */
+template <class I, class S, class T>
+void csr_matvec_mixed(const I n_row,
+                      const I n_col,
+                      const I Ap[],
+                      const I Aj[],
+                      const S Ax[],
+                      const T Xx[],
+                            T Yx[])
+{
+    typedef typename mixed_accumulator<T>::type A;
+
+    #pragma omp parallel for schedule(static) if(Ap[n_row] > parallel_threshold)
+    for(I i = 0; i < n_row; i++){
+        A sum = A(Yx[i]);
+        for(I jj = Ap[i]; jj < Ap[i+1]; jj++){
+            sum += A(Ax[jj]) * A(Xx[Aj[jj]]);
+        }
+        Yx[i] = T(sum);
+    }
+}
+
+
+/*
+ * Compute Y += A*X for CSR matrix A stored in a narrower type than
+ * the dense block vectors X,Y
+ *
+ *
+ * Input Arguments:
+ *   I  n_row            - number of rows in A
+ *   I  n_col            - number of columns in A
+ *   I  n_vecs           - number of column vectors in X and Y
+ *   I  Ap[n_row+1]      - row pointer
+ *   I  Aj[nnz(A)]       - column indices
+ *   S  Ax[nnz(A)]       - nonzeros, in the storage type
+ *   T  Xx[n_col,n_vecs] - input vector
+ *
+ * Output Arguments:
+ *   T  Yx[n_row,n_vecs] - output vector
+ *
+ * Note:
+ *   See csr_matvec_mixed.  A row of Y is accumulated in a buffer of
+ *   mixed_accumulator<T> values and rounded to T once.
+ *
+ */
+template <class I, class S, class T>
+void csr_matvecs_mixed(const I n_row,
+                       const I n_col,
+                       const I n_vecs,
+                       const I Ap[],
+                       const I Aj[],
+                       const S Ax[],
+                       const T Xx[],
+                             T Yx[])
+{
+    typedef typename mixed_accumulator<T>::type A;
+
+    #pragma omp parallel if((npy_intp)Ap[n_row] * n_vecs > parallel_threshold)
+    {
+        std::vector<A> sum(n_vecs);
+
+        #pragma omp for schedule(static)
+        for(I i = 0; i < n_row; i++){
+            T * y = Yx + (npy_intp)n_vecs * i;
+            for(I k = 0; k < n_vecs; k++){
+                sum[k] = A(y[k]);
+            }
+            for(I jj = Ap[i]; jj < Ap[i+1]; jj++){
+                const A a = A(Ax[jj]);
+                const T * x = Xx + (npy_intp)n_vecs * Aj[jj];
+                for(I k = 0; k < n_vecs; k++){
+                    sum[k] += a * A(x[k]);
+                }
+            }
+            for(I k = 0; k < n_vecs; k++){
+                y[k] = T(sum[k]);
+            }
+        }
+    }
+}
+
+#endif
@@ -0,0 +1,93 @@
+#ifndef __MATVEC_OPS_H__
+#define __MATVEC_OPS_H__
+
+/*
+ * The two parallel strategies of csr_matvec_transpose in matvec.h.
+ * They are kept apart from matvec.h because generate_functions.py
+ * wraps every template of that header, and these are not entry points
+ * (nor do they exist without OpenMP).
+ */
+
+#include <vector>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "util.h"
+
+
+#ifdef _OPENMP
+/*
+ * Parallel Y += A^T*X with one private copy of Y per thread
+ *
+ * Each thread scatters its rows into its own buffer, then the
+ * buffers are summed into Y, column-parallel.  Extra memory is
+ * O(n_threads * n_col).
+ *
+ */
+template <class I, class T>
+void csr_matvec_transpose_private(const I n_row,
+                                  const I n_col,
+                                  const I Ap[],
+                                  const I Aj[],
+                                  const T Ax[],
+                                  const T Xx[],
+                                        T Yx[],
+                                  const int n_threads)
+{
+    std::vector<T> work((npy_intp)n_threads * n_col, T(0));
+
+    #pragma omp parallel num_threads(n_threads)
+    {
+        T * y = &work[0] + (npy_intp)n_col * omp_get_thread_num();
+
+        #pragma omp for schedule(static)
+        for(I i = 0; i < n_row; i++){
+            const T x = Xx[i];
+            for(I jj = Ap[i]; jj < Ap[i+1]; jj++){
+                y[Aj[jj]] += Ax[jj] * x;
+            }
+        }
+
+        #pragma omp for schedule(static)
+        for(I j = 0; j < n_col; j++){
+            T sum = Yx[j];
+            for(int t = 0; t < n_threads; t++){
+                sum += work[(npy_intp)n_col * t + j];
+            }
+            Yx[j] = sum;
+        }
+    }
+}
+
+
+/*
+ * Parallel Y += A^T*X with atomic updates of Y
+ *
+ * No extra memory.  Preferred when n_col is large relative to nnz(A),
+ * where private buffers would cost more to clear and reduce than
+ * the product itself.
+ *
+ */
+template <class I, class T>
+void csr_matvec_transpose_atomic(const I n_row,
+                                 const I n_col,
+                                 const I Ap[],
+                                 const I Aj[],
+                                 const T Ax[],
+                                 const T Xx[],
+                                       T Yx[],
+                                 const int n_threads)
+{
+    #pragma omp parallel for schedule(static) num_threads(n_threads)
+    for(I i = 0; i < n_row; i++){
+        const T x = Xx[i];
+        for(I jj = Ap[i]; jj < Ap[i+1]; jj++){
+            atomic_add(Yx[Aj[jj]], T(Ax[jj] * x));
+        }
+    }
+}
+#endif
+
+#endif
@@ -0,0 +1,283 @@
+#ifndef __MMIO_H__
+#define __MMIO_H__
+
+/*
+ * Matrix Market (.mtx) coordinate files to and from CSR arrays.
+ *
+ * The reader parses a buffer holding the whole file, usually a memory
+ * map of it, in parallel chunks straight into Ap/Aj/Ax, in two passes:
+ * mm_read_csr_pass1 fills the row pointer and returns nnz(A), the
+ * caller allocates Aj and Ax, and mm_read_csr_pass2 fills them.
+ * mm_read_info gives the size and field of the matrix beforehand.
+ * The writer formats rows in parallel and writes them in order.
+ *
+ * The parsers, and mm_read_csr for C++ callers, are in mmio_ops.h.
+ * mmio.py wraps the reader and writer for Python.
+ */
+
+#include <string>
+#include <vector>
+#include <limits>
+#include <stdexcept>
+#include <cstdio>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "util.h"
+#include "canonical_ops.h"
+#include "mmio_ops.h"
+
+
+/*
+ * Read the banner and size line of a Matrix Market coordinate file
+ *
+ * Input Arguments:
+ *   I    n_bytes       - size of buf
+ *   char buf[n_bytes]  - the file
+ *
+ * Output Arguments:
+ *   I    info[5]       - n_row, n_col, number of entries in the file,
+ *                        field (0 real, 1 integer, 2 complex, 3 pattern)
+ *                        and symmetry (0 general, 1 symmetric,
+ *                        2 skew-symmetric, 3 hermitian)
+ *
+ * Note:
+ *   Symmetric files hold one triangle, so nnz(A) may be up to twice
+ *   the number of entries; mm_read_csr_pass1 returns it exactly.
+ *
+ */
+template <class I>
+void mm_read_info(const I n_bytes,
+                  const char buf[],
+                        I info[])
+{
+    const mm_header h = mm_read_header(buf, buf + n_bytes);
+    mm_check_size<I>(h);
+    if(h.nnz > std::numeric_limits<I>::max()){
+        throw std::overflow_error("number of entries does not fit in the index type");
+    }
+
+    info[0] = (I)h.n_row;
+    info[1] = (I)h.n_col;
+    info[2] = (I)h.nnz;
+    info[3] = (I)mm_field_code(h);
+    info[4] = (I)mm_symmetry_code(h);
+}
+
+
+/*
+ * Pass 1 of reading a Matrix Market coordinate file into CSR format:
+ * fill the row pointer
+ *
+ * Input Arguments:
+ *   I    n_bytes       - size of buf
+ *   char buf[n_bytes]  - the file
+ *
+ * Output Arguments:
+ *   I    Bp[n_row+1]   - row pointer, before duplicates are summed
+ *
+ * Returns:
+ *   Bp[n_row], the size to allocate Bj and Bx with
+ *
+ * Note:
+ *   Reads only the row and column indices of the entries, in parallel
+ *   chunks of lines.
+ *
+ *   Complexity: Linear in the file size plus O(n_row * n_chunks)
+ *
+ */
+template <class I>
+I mm_read_csr_pass1(const I n_bytes,
+                    const char buf[],
+                          I Bp[])
+{
+    const char * end = buf + n_bytes;
+    const mm_header h = mm_read_header(buf, end);
+    mm_check_size<I>(h);
+
+    const std::vector<const char *> chunk = mm_split_lines(h, end);
+
+    std::vector<I> counts;
+    mm_count_entries(h, end, chunk, counts);
+    mm_chunk_offsets((I)h.n_row, (int)chunk.size() - 1, counts, Bp);
+
+    return Bp[h.n_row];
+}
+
+
+/*
+ * Pass 2 of reading a Matrix Market coordinate file into CSR format:
+ * fill the entries, using the row pointer of pass 1
+ *
+ * Input Arguments:
+ *   I    n_bytes       - size of buf
+ *   char buf[n_bytes]  - the file
+ *
+ * Output Arguments:
+ *   I    Bp[n_row+1]   - row pointer, from mm_read_csr_pass1
+ *   I    Bj[nnz]       - column indices, nnz = Bp[n_row] from pass 1
+ *   T    Bx[nnz]       - nonzeros
+ *
+ * Returns:
+ *   nnz(A), after duplicate entries are summed
+ *
+ * Note:
+ *   A is returned in canonical format: column indices sorted,
+ *   duplicate entries summed, with Bp updated to match.  Entries past
+ *   the returned nnz(A) are unused.
+ *
+ *   symmetric, skew-symmetric and hermitian files are expanded to the
+ *   full matrix.  pattern files get the value 1.  Values are parsed in
+ *   double precision; a complex file can only be read into a complex T.
+ *
+ *   The data lines are split into one chunk per thread at line
+ *   boundaries.  The indices of each chunk are counted again per
+ *   (row, chunk), which is cheap next to parsing the values; after a
+ *   prefix sum each chunk is parsed fully and scattered to its place
+ *   in Bj/Bx, as coo_tocsr does.  Rows are then sorted in parallel by
+ *   csr_sort_rows.  The number of chunks is limited so that the
+ *   per-chunk counts hold at most nnz entries.
+ *
+ *   Complexity: Linear in the file size plus O(n_row * n_chunks)
+ *
+ */
+template <class I, class T>
+I mm_read_csr_pass2(const I n_bytes,
+                    const char buf[],
+                          I Bp[],
+                          I Bj[],
+                          T Bx[])
+{
+    const char * end = buf + n_bytes;
+    const mm_header h = mm_read_header(buf, end);
+    mm_check_size<I>(h);
+
+    const I M = (I)h.n_row;
+    const I N = (I)h.n_col;
+    const I nnz = Bp[M];
+
+    const std::vector<const char *> chunk = mm_split_lines(h, end);
+    const int n_chunks = (int)chunk.size() - 1;
+
+    std::vector<I> counts;
+    mm_count_entries(h, end, chunk, counts);
+    mm_chunk_offsets(M, n_chunks, counts, Bp);
+    if(Bp[M] != nnz){
+        throw std::invalid_argument("Matrix Market entries differ from pass 1");
+    }
+
+    mm_scatter_entries(h, end, chunk, counts, Bj, Bx);
+
+    csr_sort_rows(M, N, Bp, Bj, Bx, (I)1, n_chunks > 1);
+
+    return Bp[M];
+}
+
+
+/*
+ * Write a CSR matrix to a Matrix Market coordinate file
+ *
+ * Input Arguments:
+ *   char filename[]  - path of the .mtx file, NUL-terminated
+ *   I  n_row         - number of rows in A
+ *   I  n_col         - number of columns in A
+ *   I  Ap[n_row+1]   - row pointer
+ *   I  Aj[nnz(A)]    - column indices
+ *   T  Ax[nnz(A)]    - nonzeros
+ *   I  symmetric     - write only the lower triangle, as a symmetric file
+ *
+ * Note:
+ *   The field is real, integer or complex according to T.  With
+ *   symmetric set, A is assumed to be symmetric and entries above the
+ *   diagonal are not written.
+ *
+ *   Rows are written in chunks of about 2^20 entries.  Each round
+ *   formats one chunk per thread in parallel, then writes the chunks
+ *   in order, so memory use is bounded independently of nnz(A).
+ *
+ *   Complexity: Linear.  Specifically O(nnz(A) + n_row)
+ *
+ */
+template <class I, class T>
+void mm_write_csr(const char filename[],
+                  const I n_row,
+                  const I n_col,
+                  const I Ap[],
+                  const I Aj[],
+                  const T Ax[],
+                  const I symmetric)
+{
+    npy_intp nnz = 0;
+    if(symmetric){
+        #pragma omp parallel for schedule(static) reduction(+:nnz) if(Ap[n_row] > parallel_threshold)
+        for(I i = 0; i < n_row; i++){
+            for(I jj = Ap[i]; jj < Ap[i+1]; jj++){
+                if(Aj[jj] <= i) nnz++;
+            }
+        }
+    } else {
+        nnz = Ap[n_row];
+    }
+
+    FILE * f = fopen(filename, "wb");
+    if(!f){
+        throw std::runtime_error(std::string("cannot open ") + filename);
+    }
+
+    fprintf(f, "%%%%MatrixMarket matrix coordinate %s %s\n",
+            mm_field<T>::name(), symmetric ? "symmetric" : "general");
+    fprintf(f, "%lld %lld %lld\n", (long long)n_row, (long long)n_col, (long long)nnz);
+
+    // chunk boundaries, by rows, of about chunk_nnz entries each
+    const npy_intp chunk_nnz = 1 << 20; // constant is arbitrary
+    std::vector<I> bounds(1, 0);
+    while(bounds.back() < n_row){
+        const I r0 = bounds.back();
+        const I r1 = (I)(std::upper_bound(Ap + r0, Ap + n_row, (npy_intp)Ap[r0] + chunk_nnz) - Ap);
+        bounds.push_back(std::max<I>(r1, r0 + 1));
+    }
+    const int n_bounds = (int)bounds.size() - 1;
+
+#ifdef _OPENMP
+    const int n_threads = omp_get_max_threads();
+#else
+    const int n_threads = 1;
+#endif
+    std::vector<std::string> text(n_threads);
+
+    bool ok = true;
+    for(int c0 = 0; c0 < n_bounds && ok; c0 += n_threads){
+        const int c1 = std::min(c0 + n_threads, n_bounds);
+
+        #pragma omp parallel for schedule(static, 1) if(c1 - c0 > 1)
+        for(int c = c0; c < c1; c++){
+            std::string& out = text[c - c0];
+            out.clear();
+            for(I i = bounds[c]; i < bounds[c+1]; i++){
+                for(I jj = Ap[i]; jj < Ap[i+1]; jj++){
+                    if(symmetric && Aj[jj] > i){
+                        continue;
+                    }
+                    mm_format_index(out, (npy_intp)i + 1);
+                    out += ' ';
+                    mm_format_index(out, (npy_intp)Aj[jj] + 1);
+                    mm_format_value(out, Ax[jj]);
+                    out += '\n';
+                }
+            }
+        }
+
+        for(int c = c0; c < c1 && ok; c++){
+            const std::string& out = text[c - c0];
+            ok = fwrite(out.data(), 1, out.size(), f) == out.size();
+        }
+    }
+
+    if(fclose(f) != 0 || !ok){
+        throw std::runtime_error(std::string("cannot write ") + filename);
+    }
+}
+
+#endif
@@ -0,0 +1,652 @@
+#ifndef __MMIO_OPS_H__
+#define __MMIO_OPS_H__
+
+/*
+ * Parsing and formatting helpers of the Matrix Market reader and
+ * writer in mmio.h, and mm_read_csr, the reader for C++ callers, which
+ * maps the file itself and returns std::vectors.  POSIX only (mmap).
+ */
+
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <limits>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "util.h"
+#include "canonical_ops.h"
+
+
+/*
+ * Read-only memory map of a whole file
+ *
+ * With sequential set the kernel is told the file will be read once,
+ * front to back (aggressive read-ahead, pages dropped early).
+ */
+class mm_mapped_file {
+    public:
+        explicit mm_mapped_file(const char * filename, const bool sequential = true) : data_(0), size_(0) {
+            const int fd = open(filename, O_RDONLY);
+            if(fd < 0){
+                throw std::runtime_error(std::string("cannot open ") + filename);
+            }
+            struct stat st;
+            if(fstat(fd, &st) != 0 || st.st_size == 0){
+                close(fd);
+                throw std::runtime_error(std::string("cannot read ") + filename);
+            }
+            size_ = (size_t)st.st_size;
+            void * p = mmap(0, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+            close(fd);
+            if(p == MAP_FAILED){
+                throw std::runtime_error(std::string("cannot map ") + filename);
+            }
+            if(sequential){
+                madvise(p, size_, MADV_SEQUENTIAL);
+            }
+            data_ = (const char *)p;
+        }
+        ~mm_mapped_file(){
+            munmap((void *)data_, size_);
+        }
+
+        const char * begin() const { return data_; }
+        const char * end()   const { return data_ + size_; }
+
+    private:
+        mm_mapped_file(const mm_mapped_file&);
+        mm_mapped_file& operator=(const mm_mapped_file&);
+
+        const char * data_;
+        size_t size_;
+};
+
+
+/*
+ * Banner and size line of a Matrix Market coordinate file
+ */
+struct mm_header {
+    std::string field;      // real, integer, complex or pattern
+    std::string symmetry;   // general, symmetric, skew-symmetric or hermitian
+    npy_intp n_row;
+    npy_intp n_col;
+    npy_intp nnz;           // entries stored in the file
+    const char * data;      // first line after the size line
+};
+
+
+inline const char * mm_skip_blank(const char * p, const char * end){
+    while(p < end && (*p == ' ' || *p == '\t' || *p == '\r')){
+        p++;
+    }
+    return p;
+}
+
+inline const char * mm_next_line(const char * p, const char * end){
+    const char * q = (const char *)memchr(p, '\n', end - p);
+    return q ? q + 1 : end;
+}
+
+/*
+ * Parse a non-negative decimal integer at p (after blanks).
+ * Returns the end of the number, or 0 if there is none.
+ */
+inline const char * mm_parse_int(const char * p, const char * end, npy_intp * v){
+    p = mm_skip_blank(p, end);
+    const char * first = p;
+    npy_intp x = 0;
+    while(p < end && *p >= '0' && *p <= '9'){
+        if(x > (std::numeric_limits<npy_intp>::max() - 9) / 10){
+            return 0;
+        }
+        x = 10 * x + (*p - '0');
+        p++;
+    }
+    *v = x;
+    return p == first ? 0 : p;
+}
+
+/*
+ * Parse a decimal floating point number at p (after blanks).
+ * Returns the end of the number, or 0 if there is none.
+ *
+ * Numbers with at most 19 significant digits and a decimal exponent
+ * in [-22,22] whose mantissa is below 2^53 are converted exactly by a
+ * single multiply or divide; anything else goes through strtod.
+ */
+inline const char * mm_parse_real(const char * p, const char * end, double * v){
+    static const double pow10[] = {
+        1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+    };
+
+    p = mm_skip_blank(p, end);
+    const char * first = p;
+
+    bool negative = false;
+    if(p < end && (*p == '+' || *p == '-')){
+        negative = (*p == '-');
+        p++;
+    }
+
+    unsigned long long mantissa = 0;
+    int n_digits = 0;       // significant digits kept in mantissa
+    int exponent = 0;
+    bool exact = true;
+    bool any = false;
+
+    for(; p < end && *p >= '0' && *p <= '9'; p++){
+        any = true;
+        if(n_digits < 19){
+            mantissa = 10 * mantissa + (*p - '0');
+            if(mantissa != 0) n_digits++;
+        } else {
+            exponent++;
+            exact = exact && (*p == '0');
+        }
+    }
+    if(p < end && *p == '.'){
+        for(p++; p < end && *p >= '0' && *p <= '9'; p++){
+            any = true;
+            if(n_digits < 19){
+                mantissa = 10 * mantissa + (*p - '0');
+                if(mantissa != 0) n_digits++;
+                exponent--;
+            } else {
+                exact = exact && (*p == '0');
+            }
+        }
+    }
+    if(any && p < end && (*p == 'e' || *p == 'E')){
+        const char * q = p + 1;
+        bool exp_negative = false;
+        if(q < end && (*q == '+' || *q == '-')){
+            exp_negative = (*q == '-');
+            q++;
+        }
+        if(q < end && *q >= '0' && *q <= '9'){
+            int e = 0;
+            for(; q < end && *q >= '0' && *q <= '9'; q++){
+                if(e < 100000) e = 10 * e + (*q - '0');
+            }
+            exponent += exp_negative ? -e : e;
+            p = q;
+        }
+    }
+
+    if(any && exact && mantissa < (1ULL << 53) && exponent >= -22 && exponent <= 22){
+        double x = (double)mantissa;
+        x = (exponent < 0) ? x / pow10[-exponent] : x * pow10[exponent];
+        *v = negative ? -x : x;
+        return p;
+    }
+
+    // fall back on strtod (long mantissas, large exponents, inf, nan)
+    const char * token_end = first;
+    while(token_end < end && *token_end != ' ' && *token_end != '\t' &&
+          *token_end != '\r' && *token_end != '\n'){
+        token_end++;
+    }
+    char buf[128];
+    const size_t len = token_end - first;
+    if(len == 0 || len >= sizeof(buf)){
+        return 0;
+    }
+    memcpy(buf, first, len);
+    buf[len] = '\0';
+    char * stop;
+    *v = strtod(buf, &stop);
+    return stop == buf ? 0 : first + (stop - buf);
+}
+
+
+/*
+ * Parse the banner, comments and size line of a Matrix Market file
+ */
+inline mm_header mm_read_header(const char * begin, const char * end){
+    mm_header h;
+
+    const char * line_end = mm_next_line(begin, end);
+    std::string banner(begin, line_end);
+    for(size_t n = 0; n < banner.size(); n++){
+        banner[n] = (char)tolower(banner[n]);
+    }
+
+    char object[64], format[64], field[64], symmetry[64];
+    if(sscanf(banner.c_str(), "%%%%matrixmarket %63s %63s %63s %63s",
+              object, format, field, symmetry) != 4){
+        throw std::invalid_argument("not a Matrix Market file");
+    }
+    if(std::string(object) != "matrix" || std::string(format) != "coordinate"){
+        throw std::invalid_argument("only Matrix Market coordinate matrices are supported");
+    }
+
+    h.field    = field;
+    h.symmetry = symmetry;
+    if(h.field == "double"){
+        h.field = "real";
+    }
+    if(h.field != "real" && h.field != "integer" &&
+       h.field != "complex" && h.field != "pattern"){
+        throw std::invalid_argument("unknown Matrix Market field " + h.field);
+    }
+    if(h.symmetry != "general" && h.symmetry != "symmetric" &&
+       h.symmetry != "skew-symmetric" && h.symmetry != "hermitian"){
+        throw std::invalid_argument("unknown Matrix Market symmetry " + h.symmetry);
+    }
+
+    // skip comments and blank lines
+    const char * p = line_end;
+    while(p < end){
+        const char * q = mm_skip_blank(p, end);
+        if(q < end && *q != '%' && *q != '\n'){
+            break;
+        }
+        p = mm_next_line(p, end);
+    }
+
+    const char * q = p;
+    if(!(q = mm_parse_int(q, end, &h.n_row)) ||
+       !(q = mm_parse_int(q, end, &h.n_col)) ||
+       !(q = mm_parse_int(q, end, &h.nnz))){
+        throw std::invalid_argument("invalid Matrix Market size line");
+    }
+    h.data = mm_next_line(q, end);
+
+    return h;
+}
+
+
+/*
+ * Store a parsed value (re, im) in x
+ */
+template <class T>
+inline void mm_set_value(T& x, const double re, const double im){
+    x = T(re);
+}
+
+template <class c_type, class npy_type>
+inline void mm_set_value(complex_wrapper<c_type,npy_type>& x, const double re, const double im){
+    x = complex_wrapper<c_type,npy_type>(re, im);
+}
+
+
+/*
+ * Matrix Market field written for type T
+ */
+template <class T>
+struct mm_field {
+    static const char * name(){ return "integer"; }
+};
+template <> struct mm_field<float>       { static const char * name(){ return "real"; } };
+template <> struct mm_field<double>      { static const char * name(){ return "real"; } };
+template <> struct mm_field<long double> { static const char * name(){ return "real"; } };
+template <class c_type, class npy_type>
+struct mm_field< complex_wrapper<c_type,npy_type> > {
+    static const char * name(){ return "complex"; }
+};
+
+
+/*
+ * Append " x" to out, with enough digits to round-trip
+ */
+template <class T>
+inline void mm_format_value(std::string& out, const T& x){
+    char buf[64];
+    if(std::numeric_limits<T>::is_signed){
+        snprintf(buf, sizeof(buf), " %lld", (long long)x);
+    } else {
+        snprintf(buf, sizeof(buf), " %llu", (unsigned long long)x);
+    }
+    out += buf;
+}
+
+inline void mm_format_value(std::string& out, const float& x){
+    char buf[64];
+    snprintf(buf, sizeof(buf), " %.9g", (double)x);
+    out += buf;
+}
+
+inline void mm_format_value(std::string& out, const double& x){
+    char buf[64];
+    snprintf(buf, sizeof(buf), " %.17g", x);
+    out += buf;
+}
+
+inline void mm_format_value(std::string& out, const long double& x){
+    char buf[64];
+    snprintf(buf, sizeof(buf), " %.21Lg", x);
+    out += buf;
+}
+
+template <class c_type, class npy_type>
+inline void mm_format_value(std::string& out, const complex_wrapper<c_type,npy_type>& x){
+    mm_format_value(out, x.real);
+    mm_format_value(out, x.imag);
+}
+
+inline void mm_format_index(std::string& out, npy_intp v){
+    char buf[24];
+    int n = 0;
+    do {
+        buf[n++] = (char)('0' + v % 10);
+        v /= 10;
+    } while(v > 0);
+    while(n > 0){
+        out += buf[--n];
+    }
+}
+
+
+/*
+ * Field and symmetry codes of a Matrix Market header, as returned by
+ * mm_read_info in mmio.h
+ */
+inline npy_intp mm_field_code(const mm_header& h){
+    if(h.field == "real")    return 0;
+    if(h.field == "integer") return 1;
+    if(h.field == "complex") return 2;
+    return 3; // pattern
+}
+
+inline npy_intp mm_symmetry_code(const mm_header& h){
+    if(h.symmetry == "general")   return 0;
+    if(h.symmetry == "symmetric") return 1;
+    if(h.symmetry == "skew-symmetric") return 2;
+    return 3; // hermitian
+}
+
+
+/*
+ * Check that the dimensions of a Matrix Market matrix fit in I
+ */
+template <class I>
+void mm_check_size(const mm_header& h){
+    if(h.n_row > std::numeric_limits<I>::max() || h.n_col > std::numeric_limits<I>::max()){
+        throw std::overflow_error("matrix dimensions do not fit in the index type");
+    }
+}
+
+
+/*
+ * Split the data lines of a Matrix Market file at line boundaries into
+ * one chunk per thread: chunk c is [chunk[c], chunk[c+1]).  The number
+ * of chunks is limited so that the per-chunk counts of
+ * mm_count_entries hold at most nnz entries.
+ */
+inline std::vector<const char *> mm_split_lines(const mm_header& h, const char * end){
+    int n_chunks = 1;
+#ifdef _OPENMP
+    if(omp_get_max_threads() > 1 && h.nnz > parallel_threshold && h.n_row > 0){
+        n_chunks = (int)std::min<npy_intp>(omp_get_max_threads(), std::max<npy_intp>(1, h.nnz / h.n_row));
+    }
+#endif
+    std::vector<const char *> chunk(n_chunks + 1);
+    const npy_intp data_size = end - h.data;
+    chunk[0] = h.data;
+    chunk[n_chunks] = end;
+    for(int c = 1; c < n_chunks; c++){
+        const char * p = h.data + data_size * c / n_chunks;
+        chunk[c] = (p[-1] == '\n') ? p : mm_next_line(p, end);
+    }
+    return chunk;
+}
+
+
+/*
+ * Count the entries of each (row, chunk) of a Matrix Market file,
+ * including the mirrored entries of a symmetric file, in
+ * counts[n_row*c + i].  Reads only the row and column indices.
+ */
+template <class I>
+void mm_count_entries(const mm_header& h,
+                      const char * end,
+                      const std::vector<const char *>& chunk,
+                            std::vector<I>& counts)
+{
+    const int n_chunks = (int)chunk.size() - 1;
+    const I M = (I)h.n_row;
+    const I N = (I)h.n_col;
+    const bool general = (h.symmetry == "general");
+
+    counts.assign((npy_intp)n_chunks * M, 0);
+    std::vector<npy_intp> chunk_nnz(n_chunks, 0);
+    std::vector<const char *> error(n_chunks, (const char *)0);
+
+    #pragma omp parallel for schedule(static, 1) num_threads(n_chunks) if(n_chunks > 1)
+    for(int c = 0; c < n_chunks; c++){
+        I * count = &counts[0] + (npy_intp)M * c;
+        for(const char * p = chunk[c]; p < chunk[c+1]; p = mm_next_line(p, end)){
+            const char * q = mm_skip_blank(p, end);
+            if(q == end || *q == '\n' || *q == '%'){
+                continue;
+            }
+            npy_intp i = 0, j = 0;
+            if(!(q = mm_parse_int(q, end, &i)) || !(q = mm_parse_int(q, end, &j)) ||
+               i < 1 || i > M || j < 1 || j > N){
+                error[c] = p;
+                break;
+            }
+            count[i-1]++;
+            if(!general && i != j){
+                count[j-1]++;
+            }
+            chunk_nnz[c]++;
+        }
+    }
+
+    npy_intp file_nnz = 0;
+    for(int c = 0; c < n_chunks; c++){
+        if(error[c]){
+            throw std::invalid_argument("invalid Matrix Market entry: " +
+                                        std::string(error[c], mm_next_line(error[c], end)));
+        }
+        file_nnz += chunk_nnz[c];
+    }
+    if(file_nnz != h.nnz){
+        throw std::invalid_argument("number of Matrix Market entries does not match the size line");
+    }
+}
+
+
+/*
+ * Turn the counts of mm_count_entries into the offset in Aj/Ax of each
+ * (row, chunk), by a prefix sum row-major over (row, chunk), and fill
+ * the row pointer Bp[n_row+1]
+ */
+template <class I>
+void mm_chunk_offsets(const I n_row,
+                      const int n_chunks,
+                            std::vector<I>& counts,
+                            I Bp[])
+{
+    npy_intp sum = 0;
+    for(I i = 0; i < n_row; i++){
+        Bp[i] = (I)sum;
+        for(int c = 0; c < n_chunks; c++){
+            I& count = counts[(npy_intp)n_row * c + i];
+            const I temp = count;
+            count = (I)sum;
+            sum += temp;
+        }
+    }
+    if(sum > std::numeric_limits<I>::max()){
+        throw std::overflow_error("nnz does not fit in the index type");
+    }
+    Bp[n_row] = (I)sum;
+}
+
+
+/*
+ * Parse the entries of each chunk and scatter them to the offsets of
+ * mm_chunk_offsets, mirroring the entries of a symmetric file
+ */
+template <class I, class T>
+void mm_scatter_entries(const mm_header& h,
+                        const char * end,
+                        const std::vector<const char *>& chunk,
+                              std::vector<I>& counts,
+                              I Bj[],
+                              T Bx[])
+{
+    if(h.field == "complex" && std::string(mm_field<T>::name()) != "complex"){
+        throw std::invalid_argument("cannot read a complex matrix into a real type");
+    }
+
+    const int n_chunks = (int)chunk.size() - 1;
+    const I M = (I)h.n_row;
+    const bool general   = (h.symmetry == "general");
+    const bool skew      = (h.symmetry == "skew-symmetric");
+    const bool hermitian = (h.symmetry == "hermitian");
+    const bool is_complex = (h.field == "complex");
+    const bool pattern   = (h.field == "pattern");
+    const bool integer   = (h.field == "integer");
+
+    std::vector<const char *> error(n_chunks, (const char *)0);
+
+    #pragma omp parallel for schedule(static, 1) num_threads(n_chunks) if(n_chunks > 1)
+    for(int c = 0; c < n_chunks; c++){
+        I * offset = &counts[0] + (npy_intp)M * c;
+        for(const char * p = chunk[c]; p < chunk[c+1]; p = mm_next_line(p, end)){
+            const char * q = mm_skip_blank(p, end);
+            if(q == end || *q == '\n' || *q == '%'){
+                continue;
+            }
+            npy_intp i = 0, j = 0;
+            q = mm_parse_int(q, end, &i);
+            q = mm_parse_int(q, end, &j);
+            i--;
+            j--;
+
+            T x;
+            if(pattern){
+                x = T(1);
+            } else if(integer){
+                npy_intp v;
+                const char * r = mm_skip_blank(q, end);
+                const bool negative = (r < end && *r == '-');
+                if(r < end && (*r == '-' || *r == '+')) r++;
+                if(!(q = mm_parse_int(r, end, &v))){
+                    error[c] = p;
+                    break;
+                }
+                x = T(negative ? -v : v);
+            } else {
+                double re, im = 0;
+                if(!(q = mm_parse_real(q, end, &re)) ||
+                   (is_complex && !(q = mm_parse_real(q, end, &im)))){
+                    error[c] = p;
+                    break;
+                }
+                mm_set_value(x, re, im);
+            }
+
+            const I dest = offset[i]++;
+            Bj[dest] = (I)j;
+            Bx[dest] = x;
+
+            if(!general && i != j){
+                const I mirror = offset[j]++;
+                Bj[mirror] = (I)i;
+                Bx[mirror] = skew ? T(-x) : (hermitian ? conjugate(x) : x);
+            }
+        }
+    }
+
+    for(int c = 0; c < n_chunks; c++){
+        if(error[c]){
+            throw std::invalid_argument("invalid Matrix Market entry: " +
+                                        std::string(error[c], mm_next_line(error[c], end)));
+        }
+    }
+}
+
+
+/*
+ * Read a Matrix Market coordinate file into CSR format
+ *
+ * Input Arguments:
+ *   char filename    - path of the .mtx file
+ *
+ * Output Arguments:
+ *   I  n_row         - number of rows in A
+ *   I  n_col         - number of columns in A
+ *   I  Ap[n_row+1]   - row pointer
+ *   I  Aj[nnz(A)]    - column indices
+ *   T  Ax[nnz(A)]    - nonzeros
+ *
+ * Note:
+ *   Ap, Aj, and Ax are resized as needed.  A is returned in canonical
+ *   format: column indices sorted, duplicate entries summed.  From
+ *   Python, use mm_read_csr_pass1/2 of mmio.h over a mapped buffer.
+ *
+ *   symmetric, skew-symmetric and hermitian files are expanded to the
+ *   full matrix.  pattern files get the value 1.  Values are parsed in
+ *   double precision; a complex file can only be read into a complex T.
+ *
+ *   The data lines are split into one chunk per thread at line
+ *   boundaries.  A first pass reads only the row (and, for symmetric
+ *   files, column) indices of each chunk to count entries per
+ *   (row, chunk); after a prefix sum a second pass parses each chunk
+ *   fully and scatters it to its place in Aj/Ax, as coo_tocsr does.
+ *   Rows are then sorted in parallel by csr_sort_rows.  The number of
+ *   chunks is limited so that the per-chunk counts hold at most nnz
+ *   entries.
+ *
+ *   Complexity: Linear in the file size plus O(n_row * n_chunks)
+ *
+ */
+template <class I, class T>
+void mm_read_csr(const char * filename,
+                 I * n_row,
+                 I * n_col,
+                 std::vector<I>* Ap,
+                 std::vector<I>* Aj,
+                 std::vector<T>* Ax)
+{
+    const mm_mapped_file file(filename);
+    const char * end = file.end();
+    const mm_header h = mm_read_header(file.begin(), end);
+    mm_check_size<I>(h);
+
+    const I M = (I)h.n_row;
+    const I N = (I)h.n_col;
+    *n_row = M;
+    *n_col = N;
+
+    const std::vector<const char *> chunk = mm_split_lines(h, end);
+    const int n_chunks = (int)chunk.size() - 1;
+
+    std::vector<I> counts;
+    mm_count_entries(h, end, chunk, counts);
+
+    Ap->resize(M + 1);
+    I * Bp = &(*Ap)[0];
+    mm_chunk_offsets(M, n_chunks, counts, Bp);
+
+    Aj->resize(Bp[M]);
+    Ax->resize(Bp[M]);
+    I * Bj = Bp[M] > 0 ? &(*Aj)[0] : 0;
+    T * Bx = Bp[M] > 0 ? &(*Ax)[0] : 0;
+
+    mm_scatter_entries(h, end, chunk, counts, Bj, Bx);
+
+    csr_sort_rows(M, N, Bp, Bj, Bx, (I)1, n_chunks > 1);
+
+    Aj->resize(Bp[M]);
+    Ax->resize(Bp[M]);
+}
+
+#endif
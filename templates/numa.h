@@ -0,0 +1,182 @@
+#ifndef __NUMA_H__
+#define __NUMA_H__
+
+/*
+ * NUMA placement of CSR arrays and affinity of the OpenMP threads.
+ *
+ * The row-parallel kernels split their rows with schedule(static), so
+ * thread t of a team of n_threads always processes the same block of
+ * rows (see static_block in numa_ops.h).  Once the threads are pinned
+ * to fixed cpus (numa_bind_threads), moving each row block of
+ * Ap/Aj/Ax to the node of the thread that owns it (csr_distribute)
+ * keeps every thread's stream through the matrix in local memory
+ * instead of pulling it across the interconnect from the node numpy
+ * happened to allocate on.
+ *
+ * Pinning is never done implicitly: it changes the affinity of threads
+ * that outlive the call, so the caller opts in with numa_bind_threads.
+ *
+ * The topology is read from sysfs and pages are moved with the
+ * move_pages system call, so there is no libnuma dependency.  Linux
+ * only; elsewhere, on single-node machines, and without OpenMP every
+ * function here is a no-op.
+ */
+
+#include <vector>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#ifdef __linux__
+#include <sched.h>
+#endif
+
+#include "numa_ops.h"
+
+
+/*
+ * Pin the worker threads of the default OpenMP team to one cpu each,
+ * spread over the NUMA nodes as described in numa_thread_cpus
+ *
+ * Returns the number of threads pinned.
+ *
+ * Note:
+ *   The calling thread, thread 0 of the team, is left unpinned: it is
+ *   the application's (e.g. the Python interpreter's) thread, and
+ *   processes forked from it would inherit its mask.  Pin it yourself
+ *   if the first row block should be local too.
+ *
+ *   The pinning holds for as long as the runtime reuses the same
+ *   threads, i.e. as long as the team size does not change.
+ */
+template <class I>
+I numa_bind_threads()
+{
+    int n_bound = 0;
+#if defined(__linux__) && defined(_OPENMP)
+    const numa_topology& topo = numa_get_topology();
+    if(topo.cpus.empty()){
+        return 0;
+    }
+
+    #pragma omp parallel reduction(+:n_bound)
+    {
+        const int t = omp_get_thread_num();
+        if(t > 0){
+            const std::vector<int> slot = numa_thread_cpus(topo, omp_get_num_threads());
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            CPU_SET(topo.cpus[slot[t]], &set);
+            if(sched_setaffinity(0, sizeof(set), &set) == 0){
+                n_bound++;
+            }
+        }
+    }
+#endif
+    return (I)n_bound;
+}
+
+
+/*
+ * Move the rows of CSR matrix A to the NUMA nodes of the threads that
+ * process them in the schedule(static) kernels, once the threads are
+ * pinned with numa_bind_threads
+ *
+ *
+ * Input Arguments:
+ *   I  n_row         - number of rows in A
+ *   I  n_col         - number of columns in A
+ *   I  Ap[n_row+1]   - row pointer
+ *   I  Aj[nnz(A)]    - column indices
+ *   T  Ax[nnz(A)]    - nonzeros
+ *
+ * Returns:
+ *   number of pages of Ap, Aj and Ax now on their thread's node
+ *   (0 when there is nothing to place)
+ *
+ * Note:
+ *   The contents of the arrays do not change, only where their pages
+ *   live; the arrays keep their addresses.  Every thread moves its own
+ *   block, so the moves run in parallel.  No thread is pinned here:
+ *   without numa_bind_threads the threads may migrate off the nodes
+ *   their blocks were moved to.
+ *
+ *   The placement matches a kernel only when it runs with the same
+ *   number of threads and splits rows with schedule(static); the
+ *   dynamically scheduled kernels get no locality from it.
+ *
+ *   The kernels that first touch their outputs in a static row loop
+ *   place them this way by themselves when the output comes from
+ *   numpy.empty, whose pages are not touched before the kernel runs.
+ */
+template <class I, class T>
+I csr_distribute(const I n_row,
+                 const I n_col,
+                 const I Ap[],
+                 const I Aj[],
+                 const T Ax[])
+{
+    npy_intp n_local = 0;
+#ifdef _OPENMP
+    if(numa_get_topology().n_nodes < 2){
+        return 0;
+    }
+
+    #pragma omp parallel reduction(+:n_local)
+    {
+        const int t = omp_get_thread_num();
+        const int n_threads = omp_get_num_threads();
+        const int node = numa_thread_node(t, n_threads);
+        I r0, r1;
+        static_block(n_row, n_threads, t, &r0, &r1);
+
+        n_local += numa_move_range(Ap, Ap + r0, Ap + (t == n_threads - 1 ? r1 + 1 : r1), node);
+        n_local += numa_move_range(Aj, Aj + Ap[r0], Aj + Ap[r1], node);
+        n_local += numa_move_range(Ax, Ax + Ap[r0], Ax + Ap[r1], node);
+    }
+#endif
+    return (I)n_local;
+}
+
+
+/*
+ * Move the blocks of dense vector X to the NUMA nodes of the threads
+ * that process them in a schedule(static) loop over its n entries
+ * (the output Y of csr_matvec_alpha_beta, for example)
+ *
+ *
+ * Input Arguments:
+ *   I  n             - length of X
+ *   T  Xx[n]         - vector
+ *
+ * Returns:
+ *   number of pages of Xx now on their thread's node
+ *
+ * Note:
+ *   See csr_distribute.  An input vector X of a matrix-vector product
+ *   is read by every thread; it is better left interleaved.
+ */
+template <class I, class T>
+I vector_distribute(const I n,
+                    const T Xx[])
+{
+    npy_intp n_local = 0;
+#ifdef _OPENMP
+    if(numa_get_topology().n_nodes < 2){
+        return 0;
+    }
+
+    #pragma omp parallel reduction(+:n_local)
+    {
+        const int t = omp_get_thread_num();
+        const int n_threads = omp_get_num_threads();
+        I i0, i1;
+        static_block(n, n_threads, t, &i0, &i1);
+        n_local += numa_move_range(Xx, Xx + i0, Xx + i1, numa_thread_node(t, n_threads));
+    }
+#endif
+    return (I)n_local;
+}
+
+#endif
@@ -0,0 +1,266 @@
+#ifndef __NUMA_OPS_H__
+#define __NUMA_OPS_H__
+
+/*
+ * The topology, thread placement and page moves behind numa.h, and
+ * static_block, the row split of schedule(static) loops that the
+ * kernels with per-thread blocks (krylov_ops.h, strength_ops.h) share.
+ * They return structs, vectors and void pointers, which
+ * generate_functions.py cannot wrap, so they are kept out of the
+ * built header.
+ */
+
+#include <cstdio>
+#include <vector>
+#include <algorithm>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#ifdef __linux__
+#include <sched.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#endif
+
+
+/*
+ * Rows [*begin, *end) of the n rows that thread t of n_threads gets
+ * from an OpenMP schedule(static) loop: the first n % n_threads
+ * threads take one row more than the others.  This is how both GCC
+ * and LLVM divide a static loop without a chunk size.
+ */
+template <class I>
+void static_block(const I n, const int n_threads, const int t, I * begin, I * end)
+{
+    const I q = n / n_threads;
+    const I r = n % n_threads;
+    *begin = q * t + std::min((I)t, r);
+    *end = *begin + q + (t < r ? 1 : 0);
+}
+
+
+/*
+ * CPUs usable by this process and the NUMA node of each
+ *
+ * cpus is in binding order: node by node, and within a node one cpu
+ * per physical core before any of their SMT siblings, so that threads
+ * only share a core once every core of the node is in use.
+ */
+struct numa_topology {
+    int n_nodes;
+    std::vector<int> cpus;      // allowed cpus in binding order
+    std::vector<int> cpu_node;  // node of cpus[k]
+};
+
+/*
+ * Parse a sysfs cpu list such as "0-3,8-11" from path.
+ * Returns false if the file cannot be read.
+ */
+inline bool numa_read_cpulist(const char * path, std::vector<int> * list)
+{
+    list->clear();
+    FILE * f = fopen(path, "r");
+    if(f == 0){
+        return false;
+    }
+    int a, b;
+    while(fscanf(f, "%d", &a) == 1){
+        b = a;
+        int c = fgetc(f);
+        if(c == '-'){
+            if(fscanf(f, "%d", &b) != 1){
+                break;
+            }
+            c = fgetc(f);
+        }
+        for(int k = a; k <= b; k++){
+            list->push_back(k);
+        }
+        if(c != ','){
+            break;
+        }
+    }
+    fclose(f);
+    return true;
+}
+
+inline numa_topology numa_read_topology()
+{
+    numa_topology topo;
+    topo.n_nodes = 0;
+
+#ifdef __linux__
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    if(sched_getaffinity(0, sizeof(allowed), &allowed) != 0){
+        return topo;
+    }
+
+    char path[128];
+    std::vector<int> node_cpus, siblings;
+    for(int node = 0; ; node++){
+        snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist", node);
+        if(!numa_read_cpulist(path, &node_cpus)){
+            // node numbers can have holes; possible lists the whole range
+            std::vector<int> possible;
+            numa_read_cpulist("/sys/devices/system/node/possible", &possible);
+            if(possible.empty() || node > possible.back()){
+                break;
+            }
+            continue;
+        }
+
+        // (smt rank, cpu) so that first threads of all cores come first
+        std::vector< std::pair<int,int> > order;
+        for(size_t k = 0; k < node_cpus.size(); k++){
+            const int cpu = node_cpus[k];
+            if(cpu >= CPU_SETSIZE || !CPU_ISSET(cpu, &allowed)){
+                continue;
+            }
+            snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/topology/thread_siblings_list", cpu);
+            numa_read_cpulist(path, &siblings);
+            const int rank = std::find(siblings.begin(), siblings.end(), cpu) - siblings.begin();
+            order.push_back(std::make_pair(rank, cpu));
+        }
+        if(order.empty()){
+            continue;
+        }
+        std::sort(order.begin(), order.end());
+
+        for(size_t k = 0; k < order.size(); k++){
+            topo.cpus.push_back(order[k].second);
+            topo.cpu_node.push_back(node);
+        }
+        topo.n_nodes++;
+    }
+
+    if(topo.cpus.empty()){
+        // no sysfs node information: one node with every allowed cpu
+        for(int cpu = 0; cpu < CPU_SETSIZE; cpu++){
+            if(CPU_ISSET(cpu, &allowed)){
+                topo.cpus.push_back(cpu);
+                topo.cpu_node.push_back(0);
+            }
+        }
+        topo.n_nodes = topo.cpus.empty() ? 0 : 1;
+    }
+#endif
+
+    return topo;
+}
+
+/*
+ * The topology as of the first call
+ */
+inline const numa_topology& numa_get_topology()
+{
+    static const numa_topology topo = numa_read_topology();
+    return topo;
+}
+
+
+/*
+ * Index into topo.cpus of the cpu for each of n_threads threads
+ *
+ * Threads are handed to the nodes in proportion to their cpu counts,
+ * in thread order, so consecutive threads (and thus consecutive
+ * static row blocks) share a node.  Within a node threads take the
+ * cpus in binding order, wrapping around when oversubscribed.
+ */
+inline std::vector<int> numa_thread_cpus(const numa_topology& topo, const int n_threads)
+{
+    const int n_cpus = topo.cpus.size();
+    std::vector<int> slot(n_threads, 0);
+    if(n_cpus == 0){
+        return slot;
+    }
+
+    // first index and size of each node's run in topo.cpus
+    std::vector<int> node_first(topo.n_nodes, 0), node_size(topo.n_nodes, 0);
+    int node_index = -1;
+    for(int k = 0; k < n_cpus; k++){
+        if(k == 0 || topo.cpu_node[k] != topo.cpu_node[k-1]){
+            node_index++;
+            node_first[node_index] = k;
+        }
+        node_size[node_index]++;
+    }
+
+    std::vector<int> used(topo.n_nodes, 0);
+    for(int t = 0; t < n_threads; t++){
+        const int k = (int)((npy_intp)t * n_cpus / n_threads);
+        int node = 0;
+        while(node + 1 < topo.n_nodes && node_first[node + 1] <= k){
+            node++;
+        }
+        slot[t] = node_first[node] + used[node] % node_size[node];
+        used[node]++;
+    }
+    return slot;
+}
+
+
+/*
+ * Move the pages of [begin, end) to node; a page is moved only if it
+ * starts inside the range, or if begin is the start of the whole
+ * array (first), so that the pages shared by neighbouring blocks are
+ * moved exactly once.
+ *
+ * Returns the number of pages that are on node afterwards.
+ */
+inline npy_intp numa_move_range(const void * first, const void * begin, const void * end, const int node)
+{
+    npy_intp n_local = 0;
+#ifdef __linux__
+    if(begin >= end){
+        return 0;
+    }
+    const size_t page = sysconf(_SC_PAGESIZE);
+    size_t p = ((size_t)begin + page - 1) / page * page;
+    if(begin == first){
+        p = (size_t)begin / page * page;
+    }
+    const size_t e = (size_t)end;
+
+    const int MPOL_MF_MOVE_ = 1 << 1;   // MPOL_MF_MOVE in <numaif.h>
+    const npy_intp batch = 1024;
+
+    std::vector<void*> pages;
+    std::vector<int> nodes(batch, node), status(batch);
+    pages.reserve(batch);
+    while(p < e){
+        pages.clear();
+        for(; p < e && (npy_intp)pages.size() < batch; p += page){
+            pages.push_back((void *)p);
+        }
+        if(syscall(SYS_move_pages, 0, (unsigned long)pages.size(), &pages[0],
+                   &nodes[0], &status[0], MPOL_MF_MOVE_) < 0){
+            break;
+        }
+        for(size_t k = 0; k < pages.size(); k++){
+            if(status[k] == node){
+                n_local++;
+            }
+        }
+    }
+#endif
+    return n_local;
+}
+
+
+/*
+ * NUMA node of thread t of n_threads once numa_bind_threads has run,
+ * or -1 if there is nothing to place (single node or no topology)
+ */
+inline int numa_thread_node(const int t, const int n_threads)
+{
+    const numa_topology& topo = numa_get_topology();
+    if(topo.n_nodes < 2){
+        return -1;
+    }
+    return topo.cpu_node[numa_thread_cpus(topo, n_threads)[t]];
+}
+
+#endif
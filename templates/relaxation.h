@@ -0,0 +1,330 @@
+#ifndef __RELAXATION_H__
+#define __RELAXATION_H__
+
+/*
+ * Relaxation methods (smoothers) for CSR matrices: weighted Jacobi and
+ * multicolor Gauss-Seidel.
+ *
+ * Gauss-Seidel is parallelized by a coloring of the rows: rows of one
+ * color do not couple, so they can be relaxed at the same time, and
+ * the colors are swept one after another.  The coloring depends only
+ * on the sparsity pattern, so it is computed once by
+ * vertex_coloring_greedy and then passed to every sweep on that
+ * matrix.
+ *
+ * Sweep directions:
+ *   0  forward    rows (Jacobi) or colors (Gauss-Seidel) in increasing order
+ *   1  backward   in decreasing order
+ *   2  symmetric  a forward sweep followed by a backward sweep
+ *
+ * The row update they share is in relaxation_ops.h.
+ */
+
+#include <vector>
+#include <algorithm>
+#include <stdexcept>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "util.h"
+#include "relaxation_ops.h"
+
+
+/*
+ * Color the rows of A greedily so that no two rows of one color are
+ * coupled by a nonzero of A or A^T
+ *
+ *
+ * Input Arguments:
+ *   I  n_row         - number of rows (and columns) in A
+ *   I  Ap[n_row+1]   - row pointer
+ *   I  Aj[nnz(A)]    - column indices
+ *
+ * Output Arguments:
+ *   I  colors[n_row]       - color of each row
+ *   I  color_ptr[n_row+1]  - rows of color c are
+ *   I  color_rows[n_row]     color_rows[color_ptr[c]:color_ptr[c+1]]
+ *
+ * Returns:
+ *   the number of colors, n_colors; only color_ptr[0:n_colors+1] is
+ *   written
+ *
+ * Note:
+ *   Output arrays must be preallocated.
+ *
+ *   Rows are colored first fit, in parallel: every row takes the
+ *   smallest color none of its neighbours has, then rows that ended
+ *   up with the color of a lower-numbered neighbour are recolored in
+ *   another round (Gebremedhin and Manne).  With more than one thread
+ *   the coloring can differ from run to run; keep it with the matrix.
+ *
+ *   Within a color the rows are in increasing order.
+ *
+ *   Complexity: O(nnz(A)) per round, plus a transpose of the pattern.
+ *
+ */
+template <class I>
+I vertex_coloring_greedy(const I n_row,
+                         const I Ap[],
+                         const I Aj[],
+                               I colors[],
+                               I color_ptr[],
+                               I color_rows[])
+{
+    if(n_row == 0){
+        color_ptr[0] = 0;
+        return 0;
+    }
+
+    // pattern of A^T, so that both couplings of a row can be checked
+    std::vector<I> Tp(n_row + 1, 0), Ti(Ap[n_row]);
+    for(I jj = 0; jj < Ap[n_row]; jj++){
+        Tp[Aj[jj] + 1]++;
+    }
+    for(I i = 0; i < n_row; i++){
+        Tp[i+1] += Tp[i];
+    }
+    {
+        std::vector<I> next(Tp.begin(), Tp.end() - 1);
+        for(I i = 0; i < n_row; i++){
+            for(I jj = Ap[i]; jj < Ap[i+1]; jj++){
+                Ti[next[Aj[jj]]++] = i;
+            }
+        }
+    }
+
+    I max_degree = 0;
+    for(I i = 0; i < n_row; i++){
+        max_degree = std::max(max_degree, (Ap[i+1] - Ap[i]) + (Tp[i+1] - Tp[i]));
+    }
+
+    #pragma omp parallel for schedule(static)
+    for(I i = 0; i < n_row; i++){
+        colors[i] = -1;
+    }
+
+    std::vector<I> work(n_row);
+    for(I i = 0; i < n_row; i++){
+        work[i] = i;
+    }
+
+    while(!work.empty()){
+        const I n_work = work.size();
+        std::vector<I> conflicts;
+
+        #pragma omp parallel
+        {
+            // forbidden[c] == v marks color c as taken by a neighbour of v
+            std::vector<I> forbidden(max_degree + 2, -1);
+
+            #pragma omp for schedule(dynamic, 64)
+            for(I k = 0; k < n_work; k++){
+                const I v = work[k];
+                for(I jj = Ap[v]; jj < Ap[v+1]; jj++){
+                    I c;
+                    #pragma omp atomic read
+                    c = colors[Aj[jj]];
+                    if(c >= 0 && Aj[jj] != v){ forbidden[c] = v; }
+                }
+                for(I jj = Tp[v]; jj < Tp[v+1]; jj++){
+                    I c;
+                    #pragma omp atomic read
+                    c = colors[Ti[jj]];
+                    if(c >= 0 && Ti[jj] != v){ forbidden[c] = v; }
+                }
+                I c = 0;
+                while(forbidden[c] == v){
+                    c++;
+                }
+                #pragma omp atomic write
+                colors[v] = c;
+            }
+
+            // a row that shares its color with a lower neighbour gives way
+            std::vector<I> local;
+            #pragma omp for schedule(dynamic, 64) nowait
+            for(I k = 0; k < n_work; k++){
+                const I v = work[k];
+                bool conflict = false;
+                for(I jj = Ap[v]; jj < Ap[v+1] && !conflict; jj++){
+                    conflict = Aj[jj] < v && colors[Aj[jj]] == colors[v];
+                }
+                for(I jj = Tp[v]; jj < Tp[v+1] && !conflict; jj++){
+                    conflict = Ti[jj] < v && colors[Ti[jj]] == colors[v];
+                }
+                if(conflict){
+                    local.push_back(v);
+                }
+            }
+            #pragma omp critical
+            conflicts.insert(conflicts.end(), local.begin(), local.end());
+        }
+
+        std::sort(conflicts.begin(), conflicts.end());
+        work.swap(conflicts);
+    }
+
+    // group the rows by color, in increasing order within a color
+    I n_colors = 0;
+    for(I i = 0; i < n_row; i++){
+        n_colors = std::max(n_colors, colors[i] + 1);
+    }
+    std::fill(color_ptr, color_ptr + n_colors + 1, 0);
+    for(I i = 0; i < n_row; i++){
+        color_ptr[colors[i] + 1]++;
+    }
+    for(I c = 0; c < n_colors; c++){
+        color_ptr[c+1] += color_ptr[c];
+    }
+    std::vector<I> next(color_ptr, color_ptr + n_colors);
+    for(I i = 0; i < n_row; i++){
+        color_rows[next[colors[i]]++] = i;
+    }
+
+    return n_colors;
+}
+
+
+/*
+ * Weighted Jacobi relaxation
+ *
+ *
+ * Input Arguments:
+ *   I  n_row         - number of rows (and columns) in A
+ *   I  Ap[n_row+1]   - row pointer
+ *   I  Aj[nnz(A)]    - column indices
+ *   T  Ax[nnz(A)]    - nonzeros
+ *   T  Bx[n_row]     - right-hand side
+ *   T  omega         - damping parameter
+ *   I  sweep         - 0 forward, 1 backward, 2 symmetric
+ *   I  iterations    - number of sweeps
+ *
+ * Input/Output Arguments:
+ *   T  Xx[n_row]     - approximate solution
+ *
+ * Note:
+ *   Every row is updated from the previous iterate, so the direction
+ *   does not change the result: a symmetric sweep is two Jacobi
+ *   sweeps, which keeps the cost of the two smoothers comparable when
+ *   one replaces the other.
+ *
+ *   The iterates alternate between Xx and one work vector, so there is
+ *   no copy per sweep.  Rows are relaxed in parallel; rows with a
+ *   zero diagonal keep their value.
+ *
+ */
+template <class I, class T>
+void jacobi_weighted(const I n_row,
+                     const I Ap[],
+                     const I Aj[],
+                     const T Ax[],
+                           T Xx[],
+                     const T Bx[],
+                     const T omega,
+                     const I sweep,
+                     const I iterations)
+{
+    relax_check_sweep(sweep);
+    const I n_sweeps = (sweep == 2 ? 2 : 1) * iterations;
+    if(n_sweeps <= 0){
+        return;
+    }
+
+    std::vector<T> work(n_row);
+    T * x = Xx;
+    T * y = work.data();
+
+    #pragma omp parallel if(Ap[n_row] > parallel_threshold)
+    for(I s = 0; s < n_sweeps; s++){
+        #pragma omp for schedule(static)
+        for(I i = 0; i < n_row; i++){
+            T xi;
+            if(relax_row(i, Ap, Aj, Ax, x, Bx, &xi)){
+                y[i] = (T(1) - omega) * x[i] + omega * xi;
+            } else {
+                y[i] = x[i];
+            }
+        }
+        // the implicit barrier above ends every thread's sweep first
+        #pragma omp single
+        std::swap(x, y);
+    }
+
+    if(x != Xx){
+        std::copy(x, x + n_row, Xx);
+    }
+}
+
+
+/*
+ * Multicolor Gauss-Seidel relaxation
+ *
+ *
+ * Input Arguments:
+ *   I  n_row         - number of rows (and columns) in A
+ *   I  Ap[n_row+1]   - row pointer
+ *   I  Aj[nnz(A)]    - column indices
+ *   T  Ax[nnz(A)]    - nonzeros
+ *   T  Bx[n_row]     - right-hand side
+ *   I  n_colors      - number of colors
+ *   I  color_ptr[n_colors+1] - rows of each color, from
+ *   I  color_rows[n_row]       vertex_coloring_greedy
+ *   I  sweep         - 0 forward, 1 backward, 2 symmetric
+ *   I  iterations    - number of sweeps
+ *
+ * Input/Output Arguments:
+ *   T  Xx[n_row]     - approximate solution
+ *
+ * Note:
+ *   Colors are relaxed one after another, the rows of each color in
+ *   parallel: this is Gauss-Seidel on A permuted to color order, and
+ *   with one color per row (color_rows = 0..n_row-1) it is ordinary
+ *   lexicographic Gauss-Seidel.  x is updated in place.
+ *
+ *   The coloring must be of the pattern of A (A and A^T), as produced
+ *   by vertex_coloring_greedy; otherwise rows of one color race.
+ *
+ */
+template <class I, class T>
+void gauss_seidel_multicolor(const I n_row,
+                             const I Ap[],
+                             const I Aj[],
+                             const T Ax[],
+                                   T Xx[],
+                             const T Bx[],
+                             const I n_colors,
+                             const I color_ptr[],
+                             const I color_rows[],
+                             const I sweep,
+                             const I iterations)
+{
+    relax_check_sweep(sweep);
+
+    #pragma omp parallel if(Ap[n_row] > parallel_threshold)
+    for(I it = 0; it < iterations; it++){
+        for(I pass = 0; pass < 2; pass++){
+            // forward in pass 0 unless backward; backward in pass 1 if symmetric
+            if((pass == 0 && sweep == 1) || (pass == 1 && sweep == 2)){
+                for(I c = n_colors - 1; c >= 0; c--){
+                    #pragma omp for schedule(static)
+                    for(I k = color_ptr[c]; k < color_ptr[c+1]; k++){
+                        const I i = color_rows[k];
+                        relax_row(i, Ap, Aj, Ax, Xx, Bx, Xx + i);
+                    }
+                }
+            } else if(pass == 0){
+                for(I c = 0; c < n_colors; c++){
+                    #pragma omp for schedule(static)
+                    for(I k = color_ptr[c]; k < color_ptr[c+1]; k++){
+                        const I i = color_rows[k];
+                        relax_row(i, Ap, Aj, Ax, Xx, Bx, Xx + i);
+                    }
+                }
+            }
+        }
+    }
+}
+
+#endif
@@ -0,0 +1,52 @@
+#ifndef __RELAXATION_OPS_H__
+#define __RELAXATION_OPS_H__
+
+/*
+ * Helpers of the smoothers in relaxation.h, kept out of that header
+ * because generate_functions.py wraps every template in it.
+ */
+
+#include <stdexcept>
+
+
+/*
+ * Solve row i of A*x = b for x[i] with the other entries of x fixed:
+ * *xi = (b[i] - sum_{j != i} A[i,j]*x[j]) / A[i,i]
+ *
+ * Returns false, leaving *xi alone, if the diagonal is zero.
+ * Duplicate diagonal entries are summed.
+ */
+template <class I, class T>
+inline bool relax_row(const I i,
+                      const I Ap[],
+                      const I Aj[],
+                      const T Ax[],
+                      const T Xx[],
+                      const T Bx[],
+                            T * xi)
+{
+    T rsum = 0;
+    T diag = 0;
+    for(I jj = Ap[i]; jj < Ap[i+1]; jj++){
+        const I j = Aj[jj];
+        if(i == j){
+            diag += Ax[jj];
+        } else {
+            rsum += Ax[jj] * Xx[j];
+        }
+    }
+    if(diag == T(0)){
+        return false;
+    }
+    *xi = (Bx[i] - rsum) / diag;
+    return true;
+}
+
+inline void relax_check_sweep(const npy_intp sweep)
+{
+    if(sweep < 0 || sweep > 2){
+        throw std::invalid_argument("sweep must be 0 (forward), 1 (backward) or 2 (symmetric)");
+    }
+}
+
+#endif
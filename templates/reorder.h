@@ -0,0 +1,215 @@
+#ifndef __REORDER_H__
+#define __REORDER_H__
+
+/*
+ * Bandwidth-reducing reordering of CSR matrices: csr_rcm computes the
+ * reverse Cuthill-McKee ordering and csr_permute applies it (or any
+ * pair of row and column permutations).
+ *
+ * The breadth-first search of csr_rcm is in reorder_ops.h.
+ */
+
+#include <vector>
+#include <algorithm>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "util.h"
+#include "canonical_ops.h"
+#include "reorder_ops.h"
+
+
+/*
+ * Compute the reverse Cuthill-McKee ordering of a CSR matrix
+ *
+ * Input Arguments:
+ *   I  n_row         - number of rows in A (A must be square)
+ *   I  Ap[n_row+1]   - row pointer
+ *   I  Aj[nnz(A)]    - column indices
+ *
+ * Output Arguments:
+ *   I  perm[n_row]   - new-to-old ordering: row perm[k] of A becomes
+ *                      row k of the reordered matrix
+ *
+ * Note:
+ *   Output array perm must be preallocated
+ *
+ *   The pattern of A is taken as an undirected graph, so it should be
+ *   structurally symmetric (use the pattern of A + A^T otherwise).
+ *   Each connected component is started from a pseudo-peripheral
+ *   node (George and Liu): from a node of minimum degree, repeatedly
+ *   move to the minimum-degree node of the last BFS level while the
+ *   depth of the level structure grows.  Neighbours are visited in
+ *   order of increasing degree, and the ordering is reversed at the
+ *   end.  Use perm with csr_permute as both row and column ordering.
+ *
+ *   Complexity: O(nnz(A) log(max degree)) per BFS, a few BFS per
+ *   component
+ *
+ */
+template <class I>
+void csr_rcm(const I n_row,
+             const I Ap[],
+             const I Aj[],
+                   I perm[])
+{
+    if(n_row == 0){
+        return;
+    }
+
+    std::vector<I> degree(n_row);
+    for(I i = 0; i < n_row; i++){
+        degree[i] = Ap[i+1] - Ap[i];
+    }
+
+    // nodes by increasing degree, to pick component start points
+    std::vector<I> by_degree(n_row);
+    for(I i = 0; i < n_row; i++){
+        by_degree[i] = i;
+    }
+    std::stable_sort(by_degree.begin(), by_degree.end(), csr_degree_less<I>(&degree[0]));
+
+    std::vector<char> done(n_row, 0);
+    std::vector<I> stamp(n_row, -1), level(n_row), order(n_row);
+    std::vector<I> neighbours;
+    I mark = 0;
+    I n_done = 0;
+
+    for(I s = 0; s < n_row; s++){
+        const I start = by_degree[s];
+        if(done[start]){
+            continue;
+        }
+
+        // Find a pseudo-peripheral node of the component.
+        I root = start, depth;
+        const I n = csr_bfs_levels(Ap, Aj, root, &done[0], &stamp[0], mark++, &level[0], &order[0], &depth);
+        for(;;){
+            I candidate = order[n-1];
+            for(I k = n - 1; k >= 0 && level[order[k]] == depth - 1; k--){
+                if(degree[order[k]] < degree[candidate]){
+                    candidate = order[k];
+                }
+            }
+            I c_depth;
+            csr_bfs_levels(Ap, Aj, candidate, &done[0], &stamp[0], mark++, &level[0], &order[0], &c_depth);
+            if(c_depth <= depth){
+                break;
+            }
+            root = candidate;
+            depth = c_depth;
+        }
+
+        // Cuthill-McKee from root.
+        I head = n_done;
+        perm[n_done++] = root;
+        done[root] = 1;
+        while(head < n_done){
+            const I v = perm[head++];
+            neighbours.clear();
+            for(I jj = Ap[v]; jj < Ap[v+1]; jj++){
+                const I u = Aj[jj];
+                if(!done[u]){
+                    done[u] = 1;
+                    neighbours.push_back(u);
+                }
+            }
+            std::stable_sort(neighbours.begin(), neighbours.end(), csr_degree_less<I>(&degree[0]));
+            for(typename std::vector<I>::const_iterator it = neighbours.begin(); it != neighbours.end(); ++it){
+                perm[n_done++] = *it;
+            }
+        }
+    }
+
+    std::reverse(perm, perm + n_row);
+}
+
+
+/*
+ * Compute B = P*A*Q^T for CSR matrix A and permutations P, Q
+ *
+ *   B[i,j] = A[rperm[i], cperm[j]]
+ *
+ * Input Arguments:
+ *   I  n_row         - number of rows in A
+ *   I  n_col         - number of columns in A
+ *   I  Ap[n_row+1]   - row pointer
+ *   I  Aj[nnz(A)]    - column indices
+ *   T  Ax[nnz(A)]    - nonzeros
+ *   I  rperm[n_row]  - new-to-old row ordering
+ *   I  cperm[n_col]  - new-to-old column ordering
+ *
+ * Output Arguments:
+ *   I  Bp[n_row+1]   - row pointer
+ *   I  Bj[nnz(A)]    - column indices
+ *   T  Bx[nnz(A)]    - nonzeros
+ *
+ * Note:
+ *   Output arrays Bp, Bj, and Bx must be preallocated
+ *
+ *   Output: column indices *will be* in sorted order (duplicates of A
+ *   are kept, in their order in A)
+ *
+ *   Rows and columns are permuted in one pass: after a prefix sum of
+ *   the permuted row lengths, each row of B is gathered from its row
+ *   of A, its column indices are mapped through the inverse of cperm
+ *   and sorted, all in parallel.  Pass rperm = cperm = perm from
+ *   csr_rcm for a symmetric reordering.
+ *
+ *   Complexity: Linear.  Specifically O(nnz(A) + n_row + n_col) plus
+ *   the per-row sorts
+ *
+ */
+template <class I, class T>
+void csr_permute(const I n_row,
+                 const I n_col,
+                 const I Ap[],
+                 const I Aj[],
+                 const T Ax[],
+                 const I rperm[],
+                 const I cperm[],
+                       I Bp[],
+                       I Bj[],
+                       T Bx[])
+{
+    bool parallel = false;
+#ifdef _OPENMP
+    parallel = omp_get_max_threads() > 1 && Ap[n_row] > parallel_threshold;
+#else
+    (void)parallel; // read only by the OpenMP pragmas
+#endif
+
+    std::vector<I> cinv(n_col);
+
+    #pragma omp parallel for schedule(static) if(parallel)
+    for(I j = 0; j < n_col; j++){
+        cinv[cperm[j]] = j;
+    }
+
+    Bp[0] = 0;
+    for(I i = 0; i < n_row; i++){
+        Bp[i+1] = Bp[i] + (Ap[rperm[i]+1] - Ap[rperm[i]]);
+    }
+
+    #pragma omp parallel if(parallel)
+    {
+        std::vector<I> tj;
+        std::vector<T> tx;
+
+        #pragma omp for schedule(dynamic, 64)
+        for(I i = 0; i < n_row; i++){
+            const I r = rperm[i];
+            I kk = Bp[i];
+            for(I jj = Ap[r]; jj < Ap[r+1]; jj++){
+                Bj[kk] = cinv[Aj[jj]];
+                Bx[kk] = Ax[jj];
+                kk++;
+            }
+            csr_sort_row((I)(Bp[i+1] - Bp[i]), n_col, Bj + Bp[i], Bx + Bp[i], tj, tx);
+        }
+    }
+}
+
+#endif
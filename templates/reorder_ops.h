@@ -0,0 +1,65 @@
+#ifndef __REORDER_OPS_H__
+#define __REORDER_OPS_H__
+
+/*
+ * The degree order and breadth-first search of csr_rcm in reorder.h.
+ * csr_bfs_levels takes a char array and returns its depth through a
+ * pointer, which generate_functions.py cannot wrap, so it is kept out
+ * of the built header.
+ */
+
+
+/*
+ * Order node numbers by degree, for the orderings of csr_rcm
+ */
+template <class I>
+struct csr_degree_less {
+    const I * degree;
+    explicit csr_degree_less(const I * d) : degree(d) {}
+    bool operator()(const I a, const I b) const { return degree[a] < degree[b]; }
+};
+
+
+/*
+ * Breadth-first level structure of the component containing root
+ *
+ * Fills order[0..n) with the nodes reached, level by level, and
+ * returns n.  level[v] is set to the level of v, and stamp[v] to
+ * mark, for every node reached; nodes with stamp[v] == mark are
+ * skipped, as are nodes with done[v] set.  depth receives the number
+ * of levels.
+ *
+ */
+template <class I>
+I csr_bfs_levels(const I Ap[],
+                 const I Aj[],
+                 const I root,
+                 const char done[],
+                       I stamp[],
+                 const I mark,
+                       I level[],
+                       I order[],
+                       I * depth)
+{
+    I head = 0, tail = 0;
+    order[tail++] = root;
+    stamp[root] = mark;
+    level[root] = 0;
+
+    while(head < tail){
+        const I v = order[head++];
+        for(I jj = Ap[v]; jj < Ap[v+1]; jj++){
+            const I u = Aj[jj];
+            if(stamp[u] != mark && !done[u]){
+                stamp[u] = mark;
+                level[u] = level[v] + 1;
+                order[tail++] = u;
+            }
+        }
+    }
+
+    *depth = level[order[tail-1]] + 1;
+    return tail;
+}
+
+#endif
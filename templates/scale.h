@@ -0,0 +1,157 @@
+#ifndef __SCALE_H__
+#define __SCALE_H__
+
+/*
+ * Two-sided diagonal scaling A = diag(R) * A * diag(C) of a CSR matrix,
+ * in place, in one pass over Ax.
+ */
+
+#include <vector>
+#include <algorithm>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "util.h"
+
+
+/*
+ * Scale the rows and columns of a CSR matrix *in place*
+ *
+ *   A[i,j] *= R[i] * C[j]      i.e. A = diag(R) * A * diag(C)
+ *
+ * Input Arguments:
+ *   I  n_row         - number of rows in A
+ *   I  n_col         - number of columns in A
+ *   I  Ap[n_row+1]   - row pointer
+ *   I  Aj[nnz(A)]    - column indices
+ *   T  Ax[nnz(A)]    - nonzeros
+ *   T  Rx[n_row]     - row scale factors
+ *   T  Cx[n_col]     - column scale factors
+ *
+ * Note:
+ *   One pass over Ax instead of csr_scale_rows followed by
+ *   csr_scale_columns.  Rows are independent, so the loop is
+ *   row-parallel and the inner loop has no dependencies.
+ *
+ *   Complexity: Linear.  Specifically O(nnz(A) + n_row)
+ *
+ */
+template <class I, class T>
+void csr_scale_rows_columns(const I n_row,
+                            const I n_col,
+                            const I Ap[],
+                            const I Aj[],
+                                  T Ax[],
+                            const T Rx[],
+                            const T Cx[])
+{
+    #pragma omp parallel for schedule(static) if(Ap[n_row] > parallel_threshold)
+    for(I i = 0; i < n_row; i++){
+        const T r = Rx[i];
+        #pragma omp simd
+        for(I jj = Ap[i]; jj < Ap[i+1]; jj++){
+            Ax[jj] = r * Ax[jj] * Cx[Aj[jj]];
+        }
+    }
+}
+
+
+/*
+ * Scale the rows and columns of a CSR matrix *in place* and return
+ * the max-norms of the scaled rows and columns
+ *
+ *   A = diag(R) * A * diag(C)
+ *   Rn[i] = max_j |A[i,j]|
+ *   Cn[j] = max_i |A[i,j]|
+ *
+ * Input Arguments:
+ *   I  n_row         - number of rows in A
+ *   I  n_col         - number of columns in A
+ *   I  Ap[n_row+1]   - row pointer
+ *   I  Aj[nnz(A)]    - column indices
+ *   T  Ax[nnz(A)]    - nonzeros
+ *   T  Rx[n_row]     - row scale factors
+ *   T  Cx[n_col]     - column scale factors
+ *
+ * Output Arguments:
+ *   T  Rn[n_row]     - max-norm of each scaled row
+ *   T  Cn[n_col]     - max-norm of each scaled column
+ *
+ * Note:
+ *   Output arrays Rn and Cn must be preallocated
+ *
+ *   This is one sweep of iterative equilibration (e.g. Ruiz scaling):
+ *   the next R and C follow from Rn and Cn without another pass over
+ *   A.  Empty rows and columns have norm 0.  For complex T the norms
+ *   are returned as |x| + 0i.
+ *
+ *   Column maxima of different rows collide, so in parallel each
+ *   thread keeps a private copy of Cn.  The team is limited so that
+ *   the copies hold at most nnz(A) entries.
+ *
+ *   Complexity: Linear.  Specifically O(nnz(A) + n_row + n_threads*n_col)
+ *
+ */
+template <class I, class T>
+void csr_scale_rows_columns_norms(const I n_row,
+                                  const I n_col,
+                                  const I Ap[],
+                                  const I Aj[],
+                                        T Ax[],
+                                  const T Rx[],
+                                  const T Cx[],
+                                        T Rn[],
+                                        T Cn[])
+{
+    int n_threads = 1;
+#ifdef _OPENMP
+    const npy_intp nnz = Ap[n_row];
+    if(nnz > parallel_threshold && n_col > 0){
+        n_threads = (int)std::min<npy_intp>(omp_get_max_threads(), std::max<npy_intp>(1, nnz / n_col));
+    }
+#endif
+
+    std::fill(Cn, Cn + n_col, T(0));
+
+    // thread 0 accumulates directly into Cn
+    std::vector<T> work((npy_intp)(n_threads - 1) * n_col, T(0));
+
+    #pragma omp parallel num_threads(n_threads) if(n_threads > 1)
+    {
+#ifdef _OPENMP
+        const int tid = omp_get_thread_num();
+#else
+        const int tid = 0;
+#endif
+        T * cn = (tid == 0) ? Cn : &work[0] + (npy_intp)n_col * (tid - 1);
+
+        #pragma omp for schedule(static)
+        for(I i = 0; i < n_row; i++){
+            const T r = Rx[i];
+            T rn = 0;
+            for(I jj = Ap[i]; jj < Ap[i+1]; jj++){
+                const I j = Aj[jj];
+                const T x = r * Ax[jj] * Cx[j];
+                const T m = magnitude(x);
+                Ax[jj] = x;
+                if(rn < m)    rn = m;
+                if(cn[j] < m) cn[j] = m;
+            }
+            Rn[i] = rn;
+        }
+
+        #pragma omp for schedule(static)
+        for(I j = 0; j < n_col; j++){
+            T m = Cn[j];
+            for(int t = 1; t < n_threads; t++){
+                const T w = work[(npy_intp)n_col * (t - 1) + j];
+                if(m < w) m = w;
+            }
+            Cn[j] = m;
+        }
+    }
+}
+
+#endif
@@ -0,0 +1,141 @@
+#ifndef __STRENGTH_H__
+#define __STRENGTH_H__
+
+/*
+ * Strength of connection for algebraic multigrid: classical
+ * (Ruge-Stuben) and symmetric (smoothed aggregation) measures, as in
+ * pyamg.
+ *
+ * Each measure keeps a subset of the entries of A, so S is built in
+ * three steps: count, prefix sum, fill.  The rows are split into one
+ * schedule(static) block per thread (see static_block in numa_ops.h).
+ * Each thread counts the strong entries of its block, the block
+ * counts are prefix-summed into offsets, and each thread fills Sp,
+ * Sj, and Sx for its block from its offset.  S is the same as the
+ * serial result for any number of threads.
+ *
+ * That filter, csr_strength_filter, and the test of each measure are
+ * in strength_ops.h.
+ */
+
+#include <vector>
+
+#include "strength_ops.h"
+
+
+/*
+ * Classical (Ruge-Stuben) strength of connection
+ *
+ *   A[i,j] is strong if |A[i,j]| >= theta * max_{k != i} |A[i,k]|
+ *
+ *
+ * Input Arguments:
+ *   I  n_row         - number of rows in A
+ *   T  theta         - strength threshold, 0 <= theta <= 1
+ *   I  Ap[n_row+1]   - row pointer
+ *   I  Aj[nnz(A)]    - column indices
+ *   T  Ax[nnz(A)]    - nonzeros
+ *
+ * Output Arguments:
+ *   I  Sp[n_row+1]   - row pointer of S
+ *   I  Sj[nnz(A)]    - column indices of S
+ *   T  Sx[nnz(A)]    - nonzeros of S (the strong entries of A)
+ *
+ * Returns:
+ *   nnz(S); only Sj[0:nnz(S)] and Sx[0:nnz(S)] are written
+ *
+ * Note:
+ *   Output arrays must be preallocated.
+ *
+ *   The diagonal is always kept.  Off-diagonal explicit zeros are
+ *   never strong.  The measure is the magnitude, so complex A is
+ *   supported; pyamg's classical_strength_of_connection_abs.
+ *
+ *   Complexity: Linear.  Specifically O(nnz(A) + n_row), in two passes
+ *   over A
+ *
+ */
+template <class I, class T>
+I classical_strength_of_connection(const I n_row,
+                                   const T theta,
+                                   const I Ap[],
+                                   const I Aj[],
+                                   const T Ax[],
+                                         I Sp[],
+                                         I Sj[],
+                                         T Sx[])
+{
+    classical_strength_keep<I,T> keep;
+    keep.Ap = Ap;
+    keep.Aj = Aj;
+    keep.Ax = Ax;
+    keep.theta = theta;
+
+    return csr_strength_filter(n_row, Ap, Aj, Ax, keep, Sp, Sj, Sx);
+}
+
+
+/*
+ * Symmetric strength of connection
+ *
+ *   A[i,j] is strong if |A[i,j]|^2 >= theta^2 * |A[i,i]| * |A[j,j]|
+ *
+ *
+ * Input Arguments:
+ *   I  n_row         - number of rows (and columns) in A
+ *   T  theta         - strength threshold, 0 <= theta <= 1
+ *   I  Ap[n_row+1]   - row pointer
+ *   I  Aj[nnz(A)]    - column indices
+ *   T  Ax[nnz(A)]    - nonzeros
+ *
+ * Output Arguments:
+ *   I  Sp[n_row+1]   - row pointer of S
+ *   I  Sj[nnz(A)]    - column indices of S
+ *   T  Sx[nnz(A)]    - nonzeros of S (the strong entries of A)
+ *
+ * Returns:
+ *   nnz(S); only Sj[0:nnz(S)] and Sx[0:nnz(S)] are written
+ *
+ * Note:
+ *   Output arrays must be preallocated.
+ *
+ *   The diagonal is always kept.  Duplicate diagonal entries are
+ *   summed before taking the magnitude.  Complex A is supported.
+ *
+ *   Complexity: Linear.  Specifically O(nnz(A) + n_row), in three
+ *   passes over A
+ *
+ */
+template <class I, class T>
+I symmetric_strength_of_connection(const I n_row,
+                                   const T theta,
+                                   const I Ap[],
+                                   const I Aj[],
+                                   const T Ax[],
+                                         I Sp[],
+                                         I Sj[],
+                                         T Sx[])
+{
+    std::vector<T> diags(n_row);
+
+    #pragma omp parallel for schedule(static) if(Ap[n_row] > parallel_threshold)
+    for(I i = 0; i < n_row; i++){
+        T diag = 0;
+        for(I jj = Ap[i]; jj < Ap[i+1]; jj++){
+            if(Aj[jj] == i){
+                diag += Ax[jj];
+            }
+        }
+        diags[i] = magnitude(diag);
+    }
+
+    symmetric_strength_keep<I,T> keep;
+    keep.Aj = Aj;
+    keep.Ax = Ax;
+    keep.diags = diags.data();
+    keep.theta2 = T(theta * theta);
+
+    return csr_strength_filter(n_row, Ap, Aj, Ax, keep, Sp, Sj, Sx);
+}
+
+#endif
@@ -0,0 +1,167 @@
+#ifndef __STRENGTH_OPS_H__
+#define __STRENGTH_OPS_H__
+
+/*
+ * The filter behind the strength measures of strength.h and the keep
+ * functor of each measure.  They are kept out of strength.h because
+ * generate_functions.py wraps every template in it, and a functor
+ * parameter cannot be wrapped.
+ */
+
+#include <vector>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "example_scipy_csr.h"
+#include "numa_ops.h"
+
+
+/*
+ * Filter the entries of CSR matrix A into S, keeping A[i,jj] when
+ * keep(i, jj, w) is true, where w = keep.row(i) is computed once per
+ * row
+ *
+ * Returns nnz(S).  Sp, Sj, and Sx must be preallocated, Sj and Sx
+ * with room for nnz(A) entries.  Kept entries stay in their order.
+ *
+ * The first block starts at offset 0, so thread 0 fills its rows in
+ * the counting pass; serially there is only that one pass.
+ */
+template <class I, class T, class Keep>
+I csr_strength_filter(const I n_row,
+                      const I Ap[],
+                      const I Aj[],
+                      const T Ax[],
+                      const Keep& keep,
+                            I Sp[],
+                            I Sj[],
+                            T Sx[])
+{
+    int n_threads = 1;
+#ifdef _OPENMP
+    if(Ap[n_row] > parallel_threshold){
+        n_threads = omp_get_max_threads();
+    }
+#endif
+
+    std::vector<T> row_value(n_threads > 1 ? n_row : 0);
+    std::vector<I> block_nnz(n_threads + 1, 0);
+    Sp[0] = 0;
+
+    #pragma omp parallel num_threads(n_threads)
+    {
+        // the team may be smaller than asked for, so the blocks are
+        // those of the threads that actually run
+        int t = 0, team = 1;
+#ifdef _OPENMP
+        t = omp_get_thread_num();
+        team = omp_get_num_threads();
+#endif
+        I i0, i1;
+        static_block(n_row, team, t, &i0, &i1);
+
+        I nnz = 0;
+        if(t == 0){
+            for(I i = i0; i < i1; i++){
+                const T w = keep.row(i);
+                for(I jj = Ap[i]; jj < Ap[i+1]; jj++){
+                    if(keep(i, jj, w)){
+                        Sj[nnz] = Aj[jj];
+                        Sx[nnz] = Ax[jj];
+                        nnz++;
+                    }
+                }
+                Sp[i+1] = nnz;
+            }
+        } else {
+            for(I i = i0; i < i1; i++){
+                const T w = keep.row(i);
+                row_value[i] = w;
+                for(I jj = Ap[i]; jj < Ap[i+1]; jj++){
+                    if(keep(i, jj, w)){
+                        nnz++;
+                    }
+                }
+            }
+        }
+        block_nnz[t+1] = nnz;
+
+        #pragma omp barrier
+        #pragma omp single
+        for(int u = 0; u < team; u++){
+            block_nnz[u+1] += block_nnz[u];
+        }
+
+        if(t > 0){
+            nnz = block_nnz[t];
+            for(I i = i0; i < i1; i++){
+                const T w = row_value[i];
+                for(I jj = Ap[i]; jj < Ap[i+1]; jj++){
+                    if(keep(i, jj, w)){
+                        Sj[nnz] = Aj[jj];
+                        Sx[nnz] = Ax[jj];
+                        nnz++;
+                    }
+                }
+                Sp[i+1] = nnz;
+            }
+        }
+    }
+
+    return Sp[n_row];
+}
+
+
+template <class I, class T>
+struct classical_strength_keep {
+    const I * Ap;
+    const I * Aj;
+    const T * Ax;
+    T theta;
+
+    // theta * max_{j != i} |A[i,j]|
+    T row(const I i) const {
+        T max_offdiagonal = 0;
+        for(I jj = Ap[i]; jj < Ap[i+1]; jj++){
+            if(Aj[jj] != i){
+                const T m = magnitude(Ax[jj]);
+                if(max_offdiagonal < m) max_offdiagonal = m;
+            }
+        }
+        return T(theta * max_offdiagonal);
+    }
+
+    bool operator()(const I i, const I jj, const T& threshold) const {
+        if(Aj[jj] == i){
+            return true;
+        }
+        return Ax[jj] != T(0) && !(magnitude(Ax[jj]) < threshold);
+    }
+};
+
+
+template <class I, class T>
+struct symmetric_strength_keep {
+    const I * Aj;
+    const T * Ax;
+    const T * diags;
+    T theta2;
+
+    // theta^2 * |A[i,i]|
+    T row(const I i) const {
+        return T(theta2 * diags[i]);
+    }
+
+    bool operator()(const I i, const I jj, const T& eps_Aii) const {
+        const I j = Aj[jj];
+        if(i == j){
+            return true;
+        }
+        const T m = magnitude(Ax[jj]);
+        return !(T(m * m) < T(eps_Aii * diags[j]));
+    }
+};
+
+#endif
@@ -0,0 +1,430 @@
+#ifndef __SUBMATRIX_H__
+#define __SUBMATRIX_H__
+
+/*
+ * Row and column gathers of CSR matrices, B = A[rows,:], A[mask,:],
+ * A[:,cols] and A[:,mask], without a round trip through COO.
+ *
+ * Each gather is two passes, as csr_matmat_pass1 and csr_matmat_pass2:
+ * pass 1 fills the row pointer of B and returns nnz(B), the caller
+ * allocates Bj and Bx, and pass 2 fills them.  Since pass 1 fixes the
+ * offset of every row of B, the rows of pass 2 are independent and
+ * are filled in parallel.
+ *
+ * Masks are integer arrays, nonzero for the rows or columns to keep;
+ * a numpy boolean mask is cast to one by call_thunk.
+ *
+ * The column maps shared by the two passes are in submatrix_ops.h.
+ */
+
+#include <vector>
+#include <algorithm>
+#include <stdexcept>
+
+#include "util.h"
+#include "submatrix_ops.h"
+
+
+/*
+ * Pass 1 of B = A[rows,:] computes the row pointer of B
+ *
+ *
+ * Input Arguments:
+ *   I  n_row            - number of rows in A
+ *   I  Ap[n_row+1]      - row pointer
+ *   I  n_row_idx        - number of rows to gather
+ *   I  rows[n_row_idx]  - row indices (negative values count from the end)
+ *
+ * Output Arguments:
+ *   I  Bp[n_row_idx+1]  - row pointer
+ *
+ * Returns:
+ *   nnz(B), the size of Bj and Bx for pass 2
+ *
+ * Note:
+ *   Output arrays must be preallocated.
+ *   Rows may be repeated and appear in any order.
+ *
+ *   Complexity: Linear.  Specifically O(n_row_idx)
+ *
+ */
+template <class I>
+I csr_row_index_pass1(const I n_row,
+                      const I Ap[],
+                      const I n_row_idx,
+                      const I rows[],
+                            I Bp[])
+{
+    npy_intp nnz = 0;
+    Bp[0] = 0;
+    for(I n = 0; n < n_row_idx; n++){
+        const I i = rows[n] < 0 ? rows[n] + n_row : rows[n];
+        nnz += Ap[i+1] - Ap[i];
+        if(nnz != (I)nnz){
+            throw std::overflow_error("nnz of the result is too large");
+        }
+        Bp[n+1] = (I)nnz;
+    }
+    return (I)nnz;
+}
+
+
+/*
+ * Pass 2 of B = A[rows,:] copies the rows into B
+ *
+ *
+ * Input Arguments:
+ *   I  n_row            - number of rows in A
+ *   I  Ap[n_row+1]      - row pointer
+ *   I  Aj[nnz(A)]       - column indices
+ *   T  Ax[nnz(A)]       - nonzeros
+ *   I  n_row_idx        - number of rows to gather
+ *   I  rows[n_row_idx]  - row indices, as in pass 1
+ *   I  Bp[n_row_idx+1]  - row pointer from csr_row_index_pass1
+ *
+ * Output Arguments:
+ *   I  Bj[nnz(B)]       - column indices
+ *   T  Bx[nnz(B)]       - nonzeros
+ *
+ * Note:
+ *   Output arrays must be preallocated.
+ *
+ *   Complexity: Linear.  Specifically O(nnz(B) + n_row_idx)
+ *
+ */
+template <class I, class T>
+void csr_row_index_pass2(const I n_row,
+                         const I Ap[],
+                         const I Aj[],
+                         const T Ax[],
+                         const I n_row_idx,
+                         const I rows[],
+                         const I Bp[],
+                               I Bj[],
+                               T Bx[])
+{
+    #pragma omp parallel for schedule(dynamic, 64) if(Bp[n_row_idx] > parallel_threshold)
+    for(I n = 0; n < n_row_idx; n++){
+        const I i = rows[n] < 0 ? rows[n] + n_row : rows[n];
+        const I row_start = Ap[i];
+        const I row_end   = Ap[i+1];
+
+        std::copy(Aj + row_start, Aj + row_end, Bj + Bp[n]);
+        std::copy(Ax + row_start, Ax + row_end, Bx + Bp[n]);
+    }
+}
+
+
+/*
+ * Pass 1 of B = A[mask,:] computes the row pointer of B
+ *
+ *
+ * Input Arguments:
+ *   I  n_row            - number of rows in A
+ *   I  Ap[n_row+1]      - row pointer
+ *   I  mask[n_row]      - nonzero for the rows to keep
+ *
+ * Output Arguments:
+ *   I  Bp[count(mask)+1] - row pointer
+ *
+ * Returns:
+ *   nnz(B), the size of Bj and Bx for pass 2
+ *
+ * Note:
+ *   Output arrays must be preallocated.
+ *
+ *   Complexity: Linear.  Specifically O(n_row)
+ *
+ */
+template <class I>
+I csr_row_mask_pass1(const I n_row,
+                     const I Ap[],
+                     const I mask[],
+                           I Bp[])
+{
+    I n = 0;
+    Bp[0] = 0;
+    for(I i = 0; i < n_row; i++){
+        if(mask[i]){
+            Bp[n+1] = Bp[n] + (Ap[i+1] - Ap[i]);
+            n++;
+        }
+    }
+    return Bp[n];
+}
+
+
+/*
+ * Pass 2 of B = A[mask,:] copies the rows into B
+ *
+ *
+ * Input Arguments:
+ *   I  n_row            - number of rows in A
+ *   I  Ap[n_row+1]      - row pointer
+ *   I  Aj[nnz(A)]       - column indices
+ *   T  Ax[nnz(A)]       - nonzeros
+ *   I  mask[n_row]      - nonzero for the rows to keep
+ *   I  Bp[count(mask)+1] - row pointer from csr_row_mask_pass1
+ *
+ * Output Arguments:
+ *   I  Bj[nnz(B)]       - column indices
+ *   T  Bx[nnz(B)]       - nonzeros
+ *
+ * Note:
+ *   Output arrays must be preallocated.
+ *
+ *   Complexity: Linear.  Specifically O(nnz(B) + n_row)
+ *
+ */
+template <class I, class T>
+void csr_row_mask_pass2(const I n_row,
+                        const I Ap[],
+                        const I Aj[],
+                        const T Ax[],
+                        const I mask[],
+                        const I Bp[],
+                              I Bj[],
+                              T Bx[])
+{
+    std::vector<I> rows;
+    for(I i = 0; i < n_row; i++){
+        if(mask[i]){
+            rows.push_back(i);
+        }
+    }
+
+    csr_row_index_pass2(n_row, Ap, Aj, Ax, (I)rows.size(), rows.data(), Bp, Bj, Bx);
+}
+
+
+/*
+ * Pass 1 of B = A[:,cols] computes the row pointer of B
+ *
+ *
+ * Input Arguments:
+ *   I  n_row            - number of rows in A
+ *   I  n_col            - number of columns in A
+ *   I  Ap[n_row+1]      - row pointer
+ *   I  Aj[nnz(A)]       - column indices
+ *   I  n_idx            - number of columns to gather
+ *   I  cols[n_idx]      - column indices (negative values count from the end)
+ *
+ * Output Arguments:
+ *   I  Bp[n_row+1]      - row pointer
+ *
+ * Returns:
+ *   nnz(B), the size of Bj and Bx for pass 2
+ *
+ * Note:
+ *   Output arrays must be preallocated.
+ *
+ *   A column of A that appears k times in cols is copied to each of
+ *   its k new positions, so rows of B may be longer than those of A.
+ *   Rows are counted in parallel.
+ *
+ *   Complexity: Linear.  Specifically O(nnz(A) + n_col + n_idx)
+ *
+ */
+template <class I>
+I csr_column_index_pass1(const I n_row,
+                         const I n_col,
+                         const I Ap[],
+                         const I Aj[],
+                         const I n_idx,
+                         const I cols[],
+                               I Bp[])
+{
+    std::vector<I> col_offsets, col_order;
+    csr_column_positions(n_col, n_idx, cols, col_offsets, col_order);
+
+    // rows of B may not fit in I before the sum is checked
+    std::vector<npy_intp> row_nnz(n_row);
+
+    #pragma omp parallel for schedule(dynamic, 64) if(Ap[n_row] > parallel_threshold)
+    for(I i = 0; i < n_row; i++){
+        npy_intp count = 0;
+        for(I jj = Ap[i]; jj < Ap[i+1]; jj++){
+            count += col_offsets[Aj[jj]+1] - col_offsets[Aj[jj]];
+        }
+        row_nnz[i] = count;
+    }
+
+    npy_intp nnz = 0;
+    Bp[0] = 0;
+    for(I i = 0; i < n_row; i++){
+        nnz += row_nnz[i];
+        if(nnz != (I)nnz){
+            throw std::overflow_error("nnz of the result is too large");
+        }
+        Bp[i+1] = (I)nnz;
+    }
+    return (I)nnz;
+}
+
+
+/*
+ * Pass 2 of B = A[:,cols] fills the columns of B
+ *
+ *
+ * Input Arguments:
+ *   I  n_row            - number of rows in A
+ *   I  n_col            - number of columns in A
+ *   I  Ap[n_row+1]      - row pointer
+ *   I  Aj[nnz(A)]       - column indices
+ *   T  Ax[nnz(A)]       - nonzeros
+ *   I  n_idx            - number of columns to gather
+ *   I  cols[n_idx]      - column indices, as in pass 1
+ *   I  Bp[n_row+1]      - row pointer from csr_column_index_pass1
+ *
+ * Output Arguments:
+ *   I  Bj[nnz(B)]       - column indices
+ *   T  Bx[nnz(B)]       - nonzeros
+ *
+ * Note:
+ *   Output arrays must be preallocated.
+ *
+ *   Output column indices *are not* in sorted order.
+ *
+ *   Complexity: Linear.  Specifically O(nnz(A) + nnz(B) + n_col + n_idx)
+ *
+ */
+template <class I, class T>
+void csr_column_index_pass2(const I n_row,
+                            const I n_col,
+                            const I Ap[],
+                            const I Aj[],
+                            const T Ax[],
+                            const I n_idx,
+                            const I cols[],
+                            const I Bp[],
+                                  I Bj[],
+                                  T Bx[])
+{
+    std::vector<I> col_offsets, col_order;
+    csr_column_positions(n_col, n_idx, cols, col_offsets, col_order);
+
+    #pragma omp parallel for schedule(dynamic, 64) if(Bp[n_row] > parallel_threshold)
+    for(I i = 0; i < n_row; i++){
+        I kk = Bp[i];
+        for(I jj = Ap[i]; jj < Ap[i+1]; jj++){
+            const I j = Aj[jj];
+            const T x = Ax[jj];
+            for(I k = col_offsets[j]; k < col_offsets[j+1]; k++){
+                Bj[kk] = col_order[k];
+                Bx[kk] = x;
+                kk++;
+            }
+        }
+    }
+}
+
+
+/*
+ * Pass 1 of B = A[:,mask] computes the row pointer of B
+ *
+ *
+ * Input Arguments:
+ *   I  n_row            - number of rows in A
+ *   I  n_col            - number of columns in A
+ *   I  Ap[n_row+1]      - row pointer
+ *   I  Aj[nnz(A)]       - column indices
+ *   I  mask[n_col]      - nonzero for the columns to keep
+ *
+ * Output Arguments:
+ *   I  Bp[n_row+1]      - row pointer
+ *
+ * Returns:
+ *   nnz(B), the size of Bj and Bx for pass 2
+ *
+ * Note:
+ *   Output arrays must be preallocated.
+ *   Rows are counted in parallel.
+ *
+ *   Complexity: Linear.  Specifically O(nnz(A) + n_col)
+ *
+ */
+template <class I>
+I csr_column_mask_pass1(const I n_row,
+                        const I n_col,
+                        const I Ap[],
+                        const I Aj[],
+                        const I mask[],
+                              I Bp[])
+{
+    std::vector<I> col_map;
+    csr_column_mask_map(n_col, mask, col_map);
+
+    Bp[0] = 0;
+
+    #pragma omp parallel for schedule(dynamic, 64) if(Ap[n_row] > parallel_threshold)
+    for(I i = 0; i < n_row; i++){
+        I row_nnz = 0;
+        for(I jj = Ap[i]; jj < Ap[i+1]; jj++){
+            if(col_map[Aj[jj]] != -1){
+                row_nnz++;
+            }
+        }
+        Bp[i+1] = row_nnz;
+    }
+
+    for(I i = 0; i < n_row; i++){
+        Bp[i+1] += Bp[i];
+    }
+    return Bp[n_row];
+}
+
+
+/*
+ * Pass 2 of B = A[:,mask] fills the columns of B
+ *
+ *
+ * Input Arguments:
+ *   I  n_row            - number of rows in A
+ *   I  n_col            - number of columns in A
+ *   I  Ap[n_row+1]      - row pointer
+ *   I  Aj[nnz(A)]       - column indices
+ *   T  Ax[nnz(A)]       - nonzeros
+ *   I  mask[n_col]      - nonzero for the columns to keep
+ *   I  Bp[n_row+1]      - row pointer from csr_column_mask_pass1
+ *
+ * Output Arguments:
+ *   I  Bj[nnz(B)]       - column indices
+ *   T  Bx[nnz(B)]       - nonzeros
+ *
+ * Note:
+ *   Output arrays must be preallocated.
+ *   Kept columns are renumbered in order, so sorted input gives
+ *   sorted output.
+ *
+ *   Complexity: Linear.  Specifically O(nnz(A) + n_col)
+ *
+ */
+template <class I, class T>
+void csr_column_mask_pass2(const I n_row,
+                           const I n_col,
+                           const I Ap[],
+                           const I Aj[],
+                           const T Ax[],
+                           const I mask[],
+                           const I Bp[],
+                                 I Bj[],
+                                 T Bx[])
+{
+    std::vector<I> col_map;
+    csr_column_mask_map(n_col, mask, col_map);
+
+    #pragma omp parallel for schedule(dynamic, 64) if(Bp[n_row] > parallel_threshold)
+    for(I i = 0; i < n_row; i++){
+        I kk = Bp[i];
+        for(I jj = Ap[i]; jj < Ap[i+1]; jj++){
+            const I j = col_map[Aj[jj]];
+            if(j != -1){
+                Bj[kk] = j;
+                Bx[kk] = Ax[jj];
+                kk++;
+            }
+        }
+    }
+}
+
+#endif
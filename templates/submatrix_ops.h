@@ -0,0 +1,63 @@
+#ifndef __SUBMATRIX_OPS_H__
+#define __SUBMATRIX_OPS_H__
+
+/*
+ * The column maps of the column gathers in submatrix.h.  Both passes
+ * of a gather build the same map; they are kept apart from
+ * submatrix.h because generate_functions.py wraps every template of
+ * that header.
+ */
+
+#include <vector>
+
+
+/*
+ * Map each column of A to its positions in cols[], in CSR form: the
+ * new positions of column j are col_order[col_offsets[j]:col_offsets[j+1]]
+ *
+ * Negative entries of cols count from the end.
+ */
+template <class I>
+void csr_column_positions(const I n_col,
+                          const I n_idx,
+                          const I cols[],
+                          std::vector<I>& col_offsets,
+                          std::vector<I>& col_order)
+{
+    col_offsets.assign(n_col + 1, 0);
+    col_order.resize(n_idx);
+
+    for(I n = 0; n < n_idx; n++){
+        const I j = cols[n] < 0 ? cols[n] + n_col : cols[n];
+        col_offsets[j+1]++;
+    }
+    for(I j = 0; j < n_col; j++){
+        col_offsets[j+1] += col_offsets[j];
+    }
+
+    std::vector<I> next(col_offsets.begin(), col_offsets.end() - 1);
+    for(I n = 0; n < n_idx; n++){
+        const I j = cols[n] < 0 ? cols[n] + n_col : cols[n];
+        col_order[next[j]++] = n;
+    }
+}
+
+
+/*
+ * New index of each column of A kept by mask, or -1 if it is dropped;
+ * kept columns are renumbered in order
+ */
+template <class I>
+void csr_column_mask_map(const I n_col,
+                         const I mask[],
+                         std::vector<I>& col_map)
+{
+    col_map.assign(n_col, -1);
+    for(I j = 0, n = 0; j < n_col; j++){
+        if(mask[j]){
+            col_map[j] = n++;
+        }
+    }
+}
+
+#endif
@@ -0,0 +1,226 @@
+#ifndef __TRIANGULAR_H__
+#define __TRIANGULAR_H__
+
+/*
+ * Sparse triangular solves with CSR matrices, parallelized by level
+ * scheduling.
+ *
+ * Row i of a lower triangular solve needs x[j] for every j < i in
+ * its row.  Level 0 holds the rows that need nothing, and level l the
+ * rows whose dependencies are all in levels below l.  Rows of one
+ * level are solved at the same time, and the levels one after
+ * another.  The levels depend only on the sparsity pattern, so they
+ * are computed once by csr_trsv_analysis and the arrays it fills, the
+ * handle (n_levels, level_ptr, level_rows), are passed to every solve
+ * with that pattern.
+ *
+ * The level loop, csr_trsv_levels, and the row solves it runs are in
+ * triangular_ops.h.
+ */
+
+#include <vector>
+#include <algorithm>
+#include <stdexcept>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "util.h"
+#include "triangular_ops.h"
+
+
+/*
+ * Compute the levels of a sparse triangular solve with CSR matrix A
+ *
+ *
+ * Input Arguments:
+ *   I  n_row         - number of rows (and columns) in A
+ *   I  Ap[n_row+1]   - row pointer
+ *   I  Aj[nnz(A)]    - column indices
+ *   I  lower         - nonzero: the lower triangle of A is solved,
+ *                      zero: the upper triangle
+ *
+ * Output Arguments:
+ *   I  level_ptr[n_row+1] - rows of level l are
+ *   I  level_rows[n_row]    level_rows[level_ptr[l]:level_ptr[l+1]]
+ *
+ * Returns:
+ *   the number of levels, n_levels; only level_ptr[0:n_levels+1] is
+ *   written
+ *
+ * Note:
+ *   Output arrays must be preallocated.
+ *
+ *   Entries of the other triangle are ignored, so the pattern of the
+ *   full matrix can be analyzed.  Within a level the rows are in
+ *   increasing order.
+ *
+ *   Complexity: Linear.  Specifically O(nnz(A) + n_row), serial
+ *
+ */
+template <class I>
+I csr_trsv_analysis(const I n_row,
+                    const I Ap[],
+                    const I Aj[],
+                    const I lower,
+                          I level_ptr[],
+                          I level_rows[])
+{
+    std::vector<I> level(n_row);
+    I n_levels = 0;
+
+    for(I k = 0; k < n_row; k++){
+        const I i = lower ? k : n_row - 1 - k;
+        I l = 0;
+        for(I jj = Ap[i]; jj < Ap[i+1]; jj++){
+            const I j = Aj[jj];
+            if(lower ? j < i : j > i){
+                l = std::max(l, (I)(level[j] + 1));
+            }
+        }
+        level[i] = l;
+        n_levels = std::max(n_levels, (I)(l + 1));
+    }
+
+    std::fill(level_ptr, level_ptr + n_levels + 1, 0);
+    for(I i = 0; i < n_row; i++){
+        level_ptr[level[i] + 1]++;
+    }
+    for(I l = 0; l < n_levels; l++){
+        level_ptr[l+1] += level_ptr[l];
+    }
+    std::vector<I> next(level_ptr, level_ptr + n_levels);
+    for(I i = 0; i < n_row; i++){
+        level_rows[next[level[i]]++] = i;
+    }
+
+    return n_levels;
+}
+
+
+/*
+ * Solve the triangular system L*x = b or U*x = b, where L (U) is the
+ * lower (upper) triangle of CSR matrix A
+ *
+ *
+ * Input Arguments:
+ *   I  n_row         - number of rows (and columns) in A
+ *   I  Ap[n_row+1]   - row pointer
+ *   I  Aj[nnz(A)]    - column indices
+ *   T  Ax[nnz(A)]    - nonzeros
+ *   I  lower         - nonzero: solve with the lower triangle,
+ *                      zero: with the upper triangle
+ *   I  unit          - nonzero: the diagonal is taken as one
+ *   I  n_levels      - handle from csr_trsv_analysis(..., lower, ...)
+ *   I  level_ptr[n_levels+1]
+ *   I  level_rows[n_row]
+ *
+ * Input/Output Arguments:
+ *   T  Xx[n_row]     - b on input, x on output
+ *
+ * Note:
+ *   Entries of the other triangle are ignored, so A may be the full
+ *   matrix (Gauss-Seidel solves with D+L) or both factors of an
+ *   incomplete LU stored together.  Duplicate diagonal entries are
+ *   summed; with unit set the stored diagonal is ignored.
+ *
+ *   Throws std::domain_error if a diagonal entry is zero (not unit);
+ *   the other rows are still solved.
+ *
+ *   Rows of a level are solved in parallel, in any order, so x is the
+ *   same as from serial substitution.  The rows of a level are spread
+ *   over A, so a bandwidth-reducing ordering (see csr_rcm)
+ *   keeps the level-scheduled accesses closer together.
+ *
+ *   Complexity: Linear.  Specifically O(nnz(A) + n_row), with one
+ *   barrier per level that has at least 64 rows per thread
+ *
+ */
+template <class I, class T>
+void csr_trsv(const I n_row,
+              const I Ap[],
+              const I Aj[],
+              const T Ax[],
+                    T Xx[],
+              const I lower,
+              const I unit,
+              const I n_levels,
+              const I level_ptr[],
+              const I level_rows[])
+{
+    csr_trsv_solve<I,T> solve_row;
+    solve_row.Ap = Ap;
+    solve_row.Aj = Aj;
+    solve_row.Ax = Ax;
+    solve_row.Xx = Xx;
+    solve_row.lower = lower;
+    solve_row.unit = unit;
+
+    const I zero_row = csr_trsv_levels(n_row, lower, n_levels, level_ptr, level_rows,
+                                       Ap[n_row] > parallel_threshold,
+                                       solve_row);
+    if(zero_row >= 0){
+        throw std::domain_error("csr_trsv: zero diagonal entry");
+    }
+}
+
+
+/*
+ * Solve the triangular system L*X = B or U*X = B for n_vecs
+ * right-hand sides, where L (U) is the lower (upper) triangle of CSR
+ * matrix A
+ *
+ *
+ * Input Arguments:
+ *   I  n_row         - number of rows (and columns) in A
+ *   I  n_vecs        - number of right-hand sides
+ *   I  Ap[n_row+1]   - row pointer
+ *   I  Aj[nnz(A)]    - column indices
+ *   T  Ax[nnz(A)]    - nonzeros
+ *   I  lower         - nonzero: solve with the lower triangle,
+ *                      zero: with the upper triangle
+ *   I  unit          - nonzero: the diagonal is taken as one
+ *   I  n_levels      - handle from csr_trsv_analysis(..., lower, ...)
+ *   I  level_ptr[n_levels+1]
+ *   I  level_rows[n_row]
+ *
+ * Input/Output Arguments:
+ *   T  Xx[n_row,n_vecs] - B on input, X on output, C-contiguous
+ *
+ * Note:
+ *   As csr_trsv; each entry of A is read once for all right-hand
+ *   sides.
+ *
+ */
+template <class I, class T>
+void csr_trsm(const I n_row,
+              const I n_vecs,
+              const I Ap[],
+              const I Aj[],
+              const T Ax[],
+                    T Xx[],
+              const I lower,
+              const I unit,
+              const I n_levels,
+              const I level_ptr[],
+              const I level_rows[])
+{
+    csr_trsm_solve<I,T> solve_row;
+    solve_row.n_vecs = n_vecs;
+    solve_row.Ap = Ap;
+    solve_row.Aj = Aj;
+    solve_row.Ax = Ax;
+    solve_row.Xx = Xx;
+    solve_row.lower = lower;
+    solve_row.unit = unit;
+
+    const I zero_row = csr_trsv_levels(n_row, lower, n_levels, level_ptr, level_rows,
+                                       (npy_intp)Ap[n_row] * n_vecs > parallel_threshold,
+                                       solve_row);
+    if(zero_row >= 0){
+        throw std::domain_error("csr_trsm: zero diagonal entry");
+    }
+}
+
+#endif
@@ -0,0 +1,222 @@
+#ifndef __TRIANGULAR_OPS_H__
+#define __TRIANGULAR_OPS_H__
+
+/*
+ * The level-scheduled loop of the triangular solves in triangular.h,
+ * csr_trsv_levels, and the row solves it runs.  csr_trsv_levels takes
+ * the row solve as a functor, which generate_functions.py cannot wrap,
+ * so these are kept out of triangular.h.  csr_ilu0 in ilu.h runs its
+ * row factorization through the same loop.
+ */
+
+#include <vector>
+#include <algorithm>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+
+/*
+ * Solve row i of a triangular system for x[i], in place
+ *
+ * Returns false, leaving x[i] at b[i] minus the off-diagonal terms,
+ * if the diagonal is needed and zero.
+ */
+template <class I, class T>
+inline bool csr_trsv_row(const I i,
+                         const I Ap[],
+                         const I Aj[],
+                         const T Ax[],
+                               T Xx[],
+                         const I lower,
+                         const I unit)
+{
+    T sum = Xx[i];
+    T diag = 0;
+    for(I jj = Ap[i]; jj < Ap[i+1]; jj++){
+        const I j = Aj[jj];
+        if(lower ? j < i : j > i){
+            sum = sum - Ax[jj] * Xx[j];
+        } else if(j == i){
+            diag += Ax[jj];
+        }
+    }
+    if(unit){
+        Xx[i] = sum;
+        return true;
+    }
+    if(diag == T(0)){
+        Xx[i] = sum;
+        return false;
+    }
+    Xx[i] = T(sum / diag);
+    return true;
+}
+
+
+/*
+ * Solve row i of a triangular system with n_vecs right-hand sides,
+ * X is (n_row, n_vecs) row-major
+ */
+template <class I, class T>
+inline bool csr_trsm_row(const I i,
+                         const I n_vecs,
+                         const I Ap[],
+                         const I Aj[],
+                         const T Ax[],
+                               T Xx[],
+                         const I lower,
+                         const I unit)
+{
+    T * x = Xx + (npy_intp)n_vecs * i;
+    T diag = 0;
+    for(I jj = Ap[i]; jj < Ap[i+1]; jj++){
+        const I j = Aj[jj];
+        if(lower ? j < i : j > i){
+            const T a = Ax[jj];
+            const T * y = Xx + (npy_intp)n_vecs * j;
+            for(I v = 0; v < n_vecs; v++){
+                x[v] = x[v] - a * y[v];
+            }
+        } else if(j == i){
+            diag += Ax[jj];
+        }
+    }
+    if(unit){
+        return true;
+    }
+    if(diag == T(0)){
+        return false;
+    }
+    for(I v = 0; v < n_vecs; v++){
+        x[v] = T(x[v] / diag);
+    }
+    return true;
+}
+
+
+/*
+ * The first of rows a and b in the natural solve order (increasing
+ * for lower, decreasing for upper), where -1 stands for no row
+ */
+template <class I>
+I csr_trsv_first_row(const I lower, const I a, const I b)
+{
+    if(a < 0 || b < 0){
+        return std::max(a, b);
+    }
+    return lower ? std::min(a, b) : std::max(a, b);
+}
+
+
+/*
+ * Run solve_row(i) for every row, level by level
+ *
+ * On one thread the rows are solved in their natural order instead,
+ * which is also a valid order and keeps the accesses to A and x
+ * sequential.  A level with fewer than 64 rows per thread is not
+ * worth a barrier: it is solved, with the small levels that follow
+ * it, by one thread.  Returns the first row in natural order with a
+ * zero diagonal, or -1, for any number of threads: each thread keeps
+ * its own first zero row and they are combined once, at the end.
+ */
+template <class I, class Solve>
+I csr_trsv_levels(const I n_row,
+                  const I lower,
+                  const I n_levels,
+                  const I level_ptr[],
+                  const I level_rows[],
+                  bool parallel,
+                  const Solve& solve_row)
+{
+    I zero_row = -1;
+
+#ifdef _OPENMP
+    parallel = parallel && omp_get_max_threads() > 1;
+#else
+    parallel = false;
+#endif
+    if(!parallel){
+        for(I k = 0; k < n_row; k++){
+            const I i = lower ? k : n_row - 1 - k;
+            if(!solve_row(i) && zero_row < 0){
+                zero_row = i;
+            }
+        }
+        return zero_row;
+    }
+
+    #pragma omp parallel
+    {
+        I small = 1;
+#ifdef _OPENMP
+        small = 64 * omp_get_num_threads(); // constant is arbitrary
+#endif
+        I local_zero = -1;
+        I l = 0;
+        while(l < n_levels){
+            if(level_ptr[l+1] - level_ptr[l] < small){
+                I l_end = l + 1;
+                while(l_end < n_levels && level_ptr[l_end+1] - level_ptr[l_end] < small){
+                    l_end++;
+                }
+                #pragma omp single
+                for(I k = level_ptr[l]; k < level_ptr[l_end]; k++){
+                    const I i = level_rows[k];
+                    if(!solve_row(i)){
+                        local_zero = csr_trsv_first_row(lower, local_zero, i);
+                    }
+                }
+                l = l_end;
+            } else {
+                #pragma omp for schedule(static)
+                for(I k = level_ptr[l]; k < level_ptr[l+1]; k++){
+                    const I i = level_rows[k];
+                    if(!solve_row(i)){
+                        local_zero = csr_trsv_first_row(lower, local_zero, i);
+                    }
+                }
+                l++;
+            }
+        }
+
+        if(local_zero >= 0){
+            #pragma omp critical
+            zero_row = csr_trsv_first_row(lower, zero_row, local_zero);
+        }
+    }
+
+    return zero_row;
+}
+
+template <class I, class T>
+struct csr_trsv_solve {
+    const I * Ap;
+    const I * Aj;
+    const T * Ax;
+    T * Xx;
+    I lower;
+    I unit;
+
+    bool operator()(const I i) const {
+        return csr_trsv_row(i, Ap, Aj, Ax, Xx, lower, unit);
+    }
+};
+
+template <class I, class T>
+struct csr_trsm_solve {
+    I n_vecs;
+    const I * Ap;
+    const I * Aj;
+    const T * Ax;
+    T * Xx;
+    I lower;
+    I unit;
+
+    bool operator()(const I i) const {
+        return csr_trsm_row(i, n_vecs, Ap, Aj, Ax, Xx, lower, unit);
+    }
+};
+
+#endif
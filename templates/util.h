@@ -0,0 +1,186 @@
+#ifndef __SPTOOLS_UTIL_H__
+#define __SPTOOLS_UTIL_H__
+
+#include <functional>
+#include <utility>
+#include <algorithm>
+#include <cmath>
+
+/*
+ * Small helpers shared by the kernels: the functors of the element-wise
+ * binary operations (csr_binop_csr and friends), the work threshold of
+ * the OpenMP kernels, the (column, value) order of the row sorts, and scalar helpers that also work for the
+ * complex and boolean wrapper types (mixed_accumulator, conjugate,
+ * magnitude, real_part, atomic_add).
+ */
+
+/*
+ * Amount of work (nonzeros, rows or vector entries) below which the
+ * OpenMP kernels run serially: starting a team costs more than a loop
+ * this short takes.  The constant is arbitrary.
+ */
+const npy_intp parallel_threshold = 10000;
+
+
+/*
+ * Return zero when dividing by zero instead of raising
+ */
+template <class T>
+struct safe_divides {
+    T operator() (const T& x, const T& y) const {
+        if(y == 0){
+            return 0;
+        } else {
+            return x/y;
+        }
+    }
+
+    typedef T first_argument_type;
+    typedef T second_argument_type;
+    typedef T result_type;
+};
+
+#define OVERRIDE_safe_divides(typ) \
+template<> inline typ safe_divides<typ>::operator()(const typ& x, const typ& y) const { return x/y; }
+
+OVERRIDE_safe_divides(float)
+OVERRIDE_safe_divides(double)
+OVERRIDE_safe_divides(long double)
+OVERRIDE_safe_divides(npy_cfloat_wrapper)
+OVERRIDE_safe_divides(npy_cdouble_wrapper)
+OVERRIDE_safe_divides(npy_clongdouble_wrapper)
+
+#undef OVERRIDE_safe_divides
+
+
+template <class T>
+struct maximum {
+    T operator() (const T& x, const T& y) const {
+        return std::max(x, y);
+    }
+};
+
+template <class T>
+struct minimum {
+    T operator() (const T& x, const T& y) const {
+        return std::min(x, y);
+    }
+};
+
+
+/*
+ * Order (key, value) pairs by key alone, for csr_sort_indices and
+ * csr_canonicalize_row
+ */
+template< class T1, class T2 >
+bool kv_pair_less(const std::pair<T1,T2>& x, const std::pair<T1,T2>& y){
+    return x.first < y.first;
+}
+
+
+/*
+ * Accumulator type of the mixed-precision kernels: single precision
+ * sums are carried in double precision
+ */
+template <class T>
+struct mixed_accumulator {
+    typedef T type;
+};
+
+template <>
+struct mixed_accumulator<npy_float> {
+    typedef npy_double type;
+};
+
+template <>
+struct mixed_accumulator<npy_cfloat_wrapper> {
+    typedef npy_cdouble_wrapper type;
+};
+
+
+/*
+ * Complex conjugate; the identity for real and integer types
+ */
+template <class T>
+inline T conjugate(const T& x){
+    return x;
+}
+
+template <class c_type, class npy_type>
+inline complex_wrapper<c_type,npy_type> conjugate(const complex_wrapper<c_type,npy_type>& x){
+    return complex_wrapper<c_type,npy_type>(x.real, -x.imag);
+}
+
+
+/*
+ * Absolute value, in the same type; |x| + 0i for complex types
+ */
+template <class T>
+inline T magnitude(const T& x){
+    return (x < 0) ? T(-x) : x;
+}
+
+template <class c_type, class npy_type>
+inline complex_wrapper<c_type,npy_type> magnitude(const complex_wrapper<c_type,npy_type>& x){
+    return complex_wrapper<c_type,npy_type>(std::sqrt(x.real * x.real + x.imag * x.imag));
+}
+
+
+/*
+ * Real part as a double, for norms and tolerances
+ */
+template <class T>
+inline double real_part(const T& x){
+    return (double)x;
+}
+
+template <class c_type, class npy_type>
+inline double real_part(const complex_wrapper<c_type,npy_type>& x){
+    return (double)x.real;
+}
+
+
+/*
+ * y += x as a single atomic update when run inside an OpenMP team.
+ *
+ * Complex addition is component-wise, so the real and imaginary
+ * parts are updated by two independent atomics.  Boolean += is a
+ * logical or, so only a true x needs to be stored.
+ */
+template <class T>
+inline void atomic_add(T& y, const T& x){
+    #pragma omp atomic
+    y += x;
+}
+
+template <class c_type, class npy_type>
+inline void atomic_add(complex_wrapper<c_type,npy_type>& y,
+                       const complex_wrapper<c_type,npy_type>& x){
+    #pragma omp atomic
+    y.real += x.real;
+    #pragma omp atomic
+    y.imag += x.imag;
+}
+
+inline void atomic_add(npy_bool_wrapper& y, const npy_bool_wrapper& x){
+    if(x.value){
+        #pragma omp atomic write
+        y.value = 1;
+    }
+}
+
+
+/*
+ * Determine whether a dense block contains any nonzero entry
+ */
+template <class I, class T>
+bool is_nonzero_block(const T block[], const I blocksize){
+    for(I i = 0; i < blocksize; i++){
+        if(block[i] != 0){
+            return true;
+        }
+    }
+    return false;
+}
+
+#endif
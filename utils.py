@@ -30,15 +30,19 @@ def identify_templates(hfile):
         - the argument list is limited to
           - I: int array
           - T: data array
+          - S: storage array (matrix values kept in their own type)
+          - P: row pointer array (index type resolved apart from I)
+          - V, W: std::vector<I>* and std::vector<T>* output arrays
+          - C: char array (a byte buffer or a NUL-terminated file name)
         - if *, then pointer type
           else, scalar
         - multiples of the same type look like I1, I2, ...
         - in addition 'const' and 'void'
         - in addition operators of the form OP&
-        - then it makes i, I, t, T, depending on type
+        - then it makes i, I, t, T, S, P depending on type
     """
 
-    types = ['i', 'I', 't', 'T']
+    types = ['i', 'I', 't', 'T', 'S', 'P']
 
     with open(hfile, 'rU') as hfid:
         text = hfid.read()
@@ -124,13 +128,20 @@ def identify_templates(hfile):
             else:
                 const.append(False)
             arg = arg.replace('const', '').strip()
-            if ('*' in arg) or ('[]' in arg):
+            if arg.startswith('std::vector'):
+                # std::vector<I>* or std::vector<T>* output
+                inner = arg[arg.index('<') + 1:].strip()
+                atype.append('V' if inner[0] == 'I' else 'W')
+            elif ('*' in arg) or ('[]' in arg):
                 atype.append(arg[0].upper())
             else:
                 atype.append(arg[0].lower())
 
         if funcret == 'void':
             spec = 'v'
+        elif funcret == 'I':
+            # an integer return value (a count) is passed back as a scalar
+            spec = 'i'
         else:
             spec = funcret
         for c, t in zip(const, atype):